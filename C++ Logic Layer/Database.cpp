@@ -1,48 +1,296 @@
 /// \file      Database.cpp
 
 #include "Database.hpp"
+#include "FastLog.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 Database::Database(int maxFilterCount) {
 	this->maxFilterCount = maxFilterCount;
 }
 
 Database::~Database(void) {
-	for (int i = 0; i < (int)filters.size(); i++) {
-		delete filters.at(i);
+	delete journal;
+	combinations.Clear();
+	filters.Clear();
+}
+
+int Database::SaveToDisk(){
+	if(journal == NULL){
+		if(!IsDirty()) return 0;
+		std::shared_ptr<const DatabaseSnapshot> snapshot = GetSnapshot();
+		if(WriteAtomic(*snapshot, filename, format) < 0) return -1;
+		savedGeneration = snapshot->generation;
+		return 0;
 	}
-	for (int i = 0; i < (int)combinations.size(); i++) {
-		delete combinations.at(i);
+	if(journalFailedGeneration != 0 || journal->GetRecordCount() >= compactThreshold) return Compact();
+	return journal->Sync();
+}
+
+int Database::OpenJournal(int syncInterval, int compactThreshold){
+	if(journal != NULL) return 0;
+	this->compactThreshold = compactThreshold;
+	Journal* j = new Journal(journalFilename, syncInterval);
+	// The database file may have been written after some of the records, it already holds those
+	uint64_t fileGeneration = savedGeneration;
+	int replayed = j->Replay([this, fileGeneration](JournalRecordType type, uint64_t recordGeneration, const std::vector<std::string>& fields) {
+		if(recordGeneration <= fileGeneration) return;
+		ApplyRecord(type, fields);
+		generation = recordGeneration;
+	});
+	if(replayed < 0 || j->Open() < 0){
+		delete j;
+		return -1;
 	}
+	journal = j;
+	return 0;
 }
 
-int Database::SaveToDisk(){
+int Database::Compact(void){
+	std::shared_ptr<const DatabaseSnapshot> snapshot = GetSnapshot();
+	if(WriteAtomic(*snapshot, filename, format) < 0) return -1;
+	return CommitSnapshot(snapshot->generation);
+}
+
+int Database::CommitSnapshot(uint64_t generation){
+	if(generation <= savedGeneration) return 0;
+	savedGeneration = generation;
+	if(journal == NULL) return 0;
+	if(journalFailedGeneration != 0){
+		// The journal ends before the failed mutation, a snapshot holding all its records replaces it
+		if(generation + 1 < journalFailedGeneration) return 0;
+		if(journal->Truncate() < 0) return -1;
+		// Mutations after this generation are in neither file, journal again once a snapshot holds them
+		if(generation == this->generation) journalFailedGeneration = 0;
+		return 0;
+	}
+	// Records after this generation are not in the snapshot, keep the journal in that case
+	if(generation != this->generation) return 0;
+	return journal->Truncate();
+}
+
+int Database::SyncJournal(void){
+	if(journal == NULL) return 0;
+	return journal->Sync();
+}
+
+bool Database::IsDirty(void){
+	return generation != savedGeneration;
+}
+
+bool Database::NeedsSnapshot(void){
+	if(!IsDirty()) return false;
+	return journal == NULL || journalFailedGeneration != 0 || journal->GetRecordCount() >= compactThreshold;
+}
+
+uint64_t Database::GetGeneration(void){
+	return generation;
+}
+
+std::shared_ptr<const DatabaseSnapshot> Database::GetSnapshot(void){
+	std::shared_ptr<const DatabaseSnapshot> current = std::atomic_load(&snapshot);
+	if(current != NULL && current->generation == generation) return current;
+	std::shared_lock<std::shared_mutex> lock(mutex);
+	std::shared_ptr<DatabaseSnapshot> copy = std::make_shared<DatabaseSnapshot>();
+	copy->generation = generation;
+	copy->filters.reserve(filters.Count());
+	std::unordered_map<FilterHandle, int> positions;
+	for(auto it = GetFilters().begin(); it != GetFilters().end(); ++it){
+		positions[it.Handle()] = (int)copy->filters.size();
+		copy->filters.push_back(*it);
+	}
+	copy->combinations.reserve(combinations.Count());
+	for(const Combination& c : GetFilterCombinations()){
+		copy->combinations.push_back(c);
+		std::vector<FilterHandle>& members = copy->combinations.back().filters;
+		for(int j = 0; j < (int)members.size(); j++){
+			members.at(j) = positions[members.at(j)];
+		}
+	}
+	std::atomic_store(&snapshot, std::shared_ptr<const DatabaseSnapshot>(copy));
+	return copy;
+}
+
+std::string Database::GetFilename(void){
+	return filename;
+}
+
+DatabaseFormat Database::GetFormat(void){
+	return format;
+}
+
+int Database::WriteAtomic(const DatabaseSnapshot& snapshot, std::string path, DatabaseFormat format){
+	std::string temporary = path + ".tmp";
+	int ret = (format == DatabaseFormat::Binary) ? SaveBinary(snapshot, temporary) : SaveText(snapshot, temporary);
+	if(ret < 0) return -1;
+	int fd = open(temporary.c_str(), O_RDONLY);
+	if(fd < 0 || fsync(fd) < 0){
+		LOG_WARNING("Database > WriteAtomic > Unable to sync file");
+		if(fd >= 0) close(fd);
+		return -1;
+	}
+	close(fd);
+	if(rename(temporary.c_str(), path.c_str()) < 0){
+		LOG_WARNING("Database > WriteAtomic > Unable to replace file");
+		return -1;
+	}
+	return 0;
+}
+
+void Database::Record(JournalRecordType type, const std::vector<std::string_view>& fields){
+	generation++;
+	if(journal == NULL || journalFailedGeneration != 0) return;
+	if(journal->Append(type, generation, fields) < 0){
+		journalFailedGeneration = generation;
+		LOG_WARNING("Database > Record > Journal failed, saving full snapshots");
+	}
+}
+
+void Database::Record(JournalRecordType type, std::initializer_list<std::string_view> fields){
+	if(journal == NULL || journalFailedGeneration != 0){
+		generation++;
+		return;
+	}
+	Record(type, std::vector<std::string_view>(fields));
+}
+
+void Database::ApplyRecord(JournalRecordType type, const std::vector<std::string>& fields){
+	switch(type){
+		case JournalRecordType::AddFilter:
+		{
+			if(fields.size() != 4) break;
+			Filter f;
+			f.index = std::atoi(fields.at(0).c_str());
+			f.id = fields.at(1);
+			f.material = fields.at(2);
+			f.thickness = fields.at(3);
+			if(AddFilter(f) < 0) break;
+			return;
+		}
+		case JournalRecordType::RemoveFilter:
+		{
+			if(fields.size() != 1) break;
+			Filter* f = GetFilterById(fields.at(0));
+			if(f != NULL) RemoveFilter(f);
+			return;
+		}
+		case JournalRecordType::AddFilterCombination:
+		{
+			if(fields.size() < 3) break;
+			Combination c;
+			c.id = fields.at(0);
+			c.name = fields.at(1);
+			c.placed = fields.at(2) == "1";
+			bool valid = true;
+			for(int i = 3; i < (int)fields.size() && valid; i++){
+				FilterHandle f = GetFilterHandle(fields.at(i));
+				valid = f != InvalidHandle;
+				c.filters.push_back(f);
+			}
+			if(!valid || AddFilterCombination(c) < 0) break;
+			return;
+		}
+		case JournalRecordType::RemoveFilterCombination:
+		{
+			if(fields.size() != 1) break;
+			RemoveFilterCombination(fields.at(0));
+			return;
+		}
+		case JournalRecordType::SetCombinationPlaced:
+		{
+			if(fields.size() != 2) break;
+			SetCombinationPlaced(fields.at(0), fields.at(1) == "1");
+			return;
+		}
+	}
+	LOG_WARNING("Database > ApplyRecord > Invalid journal record");
+}
+
+int Database::LoadFromDisk(){
+	int ret = ImportFromFile(filename);
+	if(ret == 0) AdoptFileGeneration();
+	else if(access(filename.c_str(), F_OK) == 0){
+		// Saving replaces the file, keep the original so the rejected records can be repaired
+		unlink(rejectedFilename.c_str());
+		if(link(filename.c_str(), rejectedFilename.c_str()) < 0) LOG_WARNING("Database > LoadFromDisk > Unable to keep rejected file");
+		else LOG_WARNING("Database > LoadFromDisk > Invalid file kept as database.txt.rejected");
+	}
+	return ret;
+}
+
+void Database::AdoptFileGeneration(void){
+	// Journal records are numbered on from the generation of the file
+	generation = loadedGeneration;
+	savedGeneration = loadedGeneration;
+	std::atomic_store(&snapshot, std::shared_ptr<const DatabaseSnapshot>());
+}
+
+void Database::SetFormat(DatabaseFormat format){
+	this->format = format;
+}
+
+int Database::ExportToFile(std::string path, DatabaseFormat format){
+	if(format == DatabaseFormat::Binary) return SaveBinary(*GetSnapshot(), path);
+	return SaveText(*GetSnapshot(), path);
+}
+
+int Database::ImportFromFile(std::string path){
+	std::ifstream file;
+	file.open(path, std::ifstream::binary);
+	if(!file.is_open()){
+		LOG_WARNING("Database > ImportFromFile > Unable to open file");
+		return -1;
+	}
+	char magic[sizeof(DatabaseMagic)] = {0};
+	file.read(magic, sizeof(magic));
+	file.close();
+	loadedGeneration = 0;
+	if(std::memcmp(magic, DatabaseMagic, sizeof(magic)) == 0) return LoadBinary(path);
+	return LoadText(path);
+}
+
+int Database::ConvertFile(std::string source, std::string destination, DatabaseFormat format, int maxFilterCount){
+	Database database(maxFilterCount);
+	if(database.ImportFromFile(source) < 0) return -1;
+	// The converted file has to match the journal records of the source as well
+	database.AdoptFileGeneration();
+	return database.ExportToFile(destination, format);
+}
+
+int Database::SaveText(const DatabaseSnapshot& snapshot, std::string path){
 	std::ofstream file;
-	file.open(filename, std::ofstream::trunc);
+	file.open(path, std::ofstream::trunc);
 	if(!file.is_open()){
-		Logging::LogEvent((int)LogLevels::LogWarning, "Database > SaveToDisk > Unable to open file");
+		LOG_WARNING("Database > SaveText > Unable to open file");
 		return -1;
 	}
 
 	file << "Filterunit Database File" << std::endl;
+	file << "Generation: " << snapshot.generation << std::endl;
 	file << "" << std::endl;
 
 	file << "Filters:" << std::endl;
-	for(int i = 0; i < (int)filters.size(); i++){
-		Filter* f = filters.at(i);
-		file << std::to_string(f->index) << ','
-		<< f->id << ','
-		<< f->material << ','
-		<< f->thickness << ';'
+	for(const Filter& f : snapshot.filters){
+		file << std::to_string(f.index) << ','
+		<< f.id << ','
+		<< f.material << ','
+		<< f.thickness << ';'
 		<< std::endl;
 	}
 	file << "End of filters" << std::endl;
 	file << "" << std::endl;
 	file << "Combinations:" << std::endl;
-	for(int i = 0; i < (int)combinations.size(); i++){
-		Combination* c = combinations.at(i);
-		file << c->id << ',' <<  c->name << ',' << (c->placed ? '1' : '0')  << ',' << c->filters.size();
-		for(int j = 0; j < (int)c->filters.size(); j++){
-			file << ',' << c->filters.at(j)->id;
+	for(const Combination& c : snapshot.combinations){
+		file << c.id << ',' <<  c.name << ',' << (c.placed ? '1' : '0')  << ',' << c.filters.size();
+		for(int j = 0; j < (int)c.filters.size(); j++){
+			file << ',' << snapshot.filters.at(c.filters.at(j)).id;
 		}
 		file << ';' << std::endl;
 	}
@@ -54,95 +302,360 @@ int Database::SaveToDisk(){
 	return 0;
 }
 
-int Database::LoadFromDisk(){
+int Database::SaveBinary(const DatabaseSnapshot& snapshot, std::string path){
+	std::string pool;
+	auto addString = [&pool](const std::string& str) {
+		DatabaseString ref;
+		ref.offset = (uint32_t)pool.size();
+		ref.length = (uint32_t)str.size();
+		pool += str;
+		return ref;
+	};
+
+	std::vector<DatabaseFilterRecord> filterRecords;
+	for(const Filter& f : snapshot.filters){
+		DatabaseFilterRecord record;
+		record.index = f.index;
+		record.id = addString(f.id);
+		record.material = addString(f.material);
+		record.thickness = addString(f.thickness);
+		filterRecords.push_back(record);
+	}
+
+	std::vector<DatabaseCombinationRecord> combinationRecords;
+	std::vector<uint32_t> members;
+	for(const Combination& c : snapshot.combinations){
+		DatabaseCombinationRecord record;
+		record.id = addString(c.id);
+		record.name = addString(c.name);
+		record.placed = c.placed ? 1 : 0;
+		record.firstMember = (uint32_t)members.size();
+		record.memberCount = (uint32_t)c.filters.size();
+		for(int j = 0; j < (int)c.filters.size(); j++){
+			members.push_back((uint32_t)c.filters.at(j));
+		}
+		combinationRecords.push_back(record);
+	}
+
+	DatabaseFileHeader header;
+	std::memcpy(header.magic, DatabaseMagic, sizeof(header.magic));
+	header.version = DatabaseVersion;
+	header.filterCount = (uint32_t)filterRecords.size();
+	header.combinationCount = (uint32_t)combinationRecords.size();
+	header.memberCount = (uint32_t)members.size();
+	header.stringPoolSize = (uint32_t)pool.size();
+	header.generation = snapshot.generation;
+
+	std::ofstream file;
+	file.open(path, std::ofstream::trunc | std::ofstream::binary);
+	if(!file.is_open()){
+		LOG_WARNING("Database > SaveBinary > Unable to open file");
+		return -1;
+	}
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)filterRecords.data(), filterRecords.size() * sizeof(DatabaseFilterRecord));
+	file.write((const char*)combinationRecords.data(), combinationRecords.size() * sizeof(DatabaseCombinationRecord));
+	file.write((const char*)members.data(), members.size() * sizeof(uint32_t));
+	file.write(pool.data(), pool.size());
+	file.close();
+	if(file.fail()){
+		LOG_WARNING("Database > SaveBinary > Write error");
+		return -1;
+	}
+	return 0;
+}
+
+int Database::LoadBinary(std::string path){
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0){
+		LOG_WARNING("Database > LoadBinary > Unable to open file");
+		return -1;
+	}
+	struct stat info;
+	if(fstat(fd, &info) < 0 || (size_t)info.st_size < sizeof(DatabaseFileHeader)){
+		LOG_WARNING("Database > LoadBinary > File too small");
+		close(fd);
+		return -1;
+	}
+	size_t size = (size_t)info.st_size;
+	void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED){
+		LOG_WARNING("Database > LoadBinary > Unable to map file");
+		return -1;
+	}
+
+	const char* data = (const char*)map;
+	const DatabaseFileHeader* header = (const DatabaseFileHeader*)data;
+	size_t filterOffset = sizeof(DatabaseFileHeader);
+	size_t combinationOffset = filterOffset + (size_t)header->filterCount * sizeof(DatabaseFilterRecord);
+	size_t memberOffset = combinationOffset + (size_t)header->combinationCount * sizeof(DatabaseCombinationRecord);
+	size_t poolOffset = memberOffset + (size_t)header->memberCount * sizeof(uint32_t);
+	if(header->version != DatabaseVersion || poolOffset + header->stringPoolSize != size){
+		LOG_WARNING("Database > LoadBinary > Unsupported version or corrupt file");
+		munmap(map, size);
+		return -1;
+	}
+
+	const DatabaseFilterRecord* filterRecords = (const DatabaseFilterRecord*)(data + filterOffset);
+	const DatabaseCombinationRecord* combinationRecords = (const DatabaseCombinationRecord*)(data + combinationOffset);
+	const uint32_t* members = (const uint32_t*)(data + memberOffset);
+	const char* pool = data + poolOffset;
+	uint32_t poolSize = header->stringPoolSize;
+	loadedGeneration = header->generation;
+	bool valid = true;
+	auto getString = [pool, poolSize, &valid](const DatabaseString& ref) {
+		if(ref.offset > poolSize || ref.length > poolSize - ref.offset){
+			valid = false;
+			return std::string();
+		}
+		return std::string(pool + ref.offset, ref.length);
+	};
+
+	int errors = 0;
+	std::vector<FilterHandle> handles(header->filterCount, InvalidHandle);
+	for(uint32_t i = 0; i < header->filterCount && valid; i++){
+		Filter f;
+		f.index = filterRecords[i].index;
+		f.id = getString(filterRecords[i].id);
+		f.material = getString(filterRecords[i].material);
+		f.thickness = getString(filterRecords[i].thickness);
+		if(!valid) break;
+		if(AddFilter(f) == 0) handles[i] = filterIndex[f.id];
+		else{
+			LOG_WARNING_VALUE("Database > LoadBinary > Invalid filter record", i);
+			errors++;
+		}
+	}
+	for(uint32_t i = 0; i < header->combinationCount && valid; i++){
+		const DatabaseCombinationRecord& record = combinationRecords[i];
+		if(record.firstMember > header->memberCount || record.memberCount > header->memberCount - record.firstMember){
+			valid = false;
+			break;
+		}
+		Combination c;
+		c.id = getString(record.id);
+		c.name = getString(record.name);
+		c.placed = record.placed != 0;
+		bool knownMembers = true;
+		for(uint32_t j = 0; j < record.memberCount && knownMembers; j++){
+			uint32_t member = members[record.firstMember + j];
+			knownMembers = member < header->filterCount && handles[member] != InvalidHandle;
+			if(knownMembers) c.filters.push_back(handles[member]);
+		}
+		if(!valid) break;
+		if(!knownMembers || AddFilterCombination(c) < 0){
+			LOG_WARNING_VALUE("Database > LoadBinary > Invalid combination record", i);
+			errors++;
+		}
+	}
+	munmap(map, size);
+	if(!valid){
+		LOG_WARNING("Database > LoadBinary > Corrupt record");
+		return -1;
+	}
+	return errors == 0 ? 0 : -1;
+}
+
+int Database::LoadText(std::string path){
 	std::ifstream file;
-	file.open(filename);
+	file.open(path, std::ifstream::binary | std::ifstream::ate);
 	if(!file.is_open()){
-		Logging::LogEvent((int)LogLevels::LogWarning, "Database > LoadFromDisk > Unable to open file");
+		LOG_WARNING("Database > LoadText > Unable to open file");
 		return -1;
 	}
+	std::string buffer((size_t)file.tellg(), '\0');
+	file.seekg(0);
+	file.read(&buffer[0], buffer.size());
+	if(file.fail()){
+		LOG_WARNING("Database > LoadText > Read error");
+		file.close();
+		return -1;
+	}
+	file.close();
+	// Every line holds at most one record, size the id index once instead of rehashing while parsing
+	filterIndex.reserve(filterIndex.size() + std::count(buffer.begin(), buffer.end(), '\n'));
+
 	bool parsingFilters = false;
 	bool parsingCombinations = false;
-	std::string line = "";
-	while(true){
-		std::getline(file, line);
-
-		if(file.eof()) break;
-		else if (!file.good()){
-			Logging::LogEvent((int)LogLevels::LogWarning, "Database > LoadFromDisk > Read error");
-			file.close();
-			return -1;
-		}
+	int errors = 0;
+	int lineNumber = 0;
+	std::vector<std::string_view> fields;
+	std::string_view text(buffer);
+	while(!text.empty()){
+		size_t end = text.find('\n');
+		std::string_view line = text.substr(0, end);
+		text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+		lineNumber++;
+		if(!line.empty() && line.back() == '\r') line.remove_suffix(1);
 
 		if(line == "End of filters") parsingFilters = false;
 		else if(line == "End of combinations") parsingCombinations = false;
-		else if(parsingFilters){
-			Filter* f = new Filter();
-			std::stringstream ss(line);
-			std::string index;
-			std::getline(ss, index, splitChar);
-			f->index = std::stoi(index);
-			std::getline(ss, f->id, splitChar);
-			std::getline(ss, f->material, splitChar);
-			std::getline(ss, f->thickness, endlChar);
-
-			AddFilter(f);
-		}
-		else if(parsingCombinations){
-			Combination* c = new Combination();
-			std::stringstream ss(line);
-			std::getline(ss, c->id, splitChar);
-			std::getline(ss, c->name, splitChar);
-			std::string placed;
-			std::getline(ss, placed, splitChar);
-			if(placed == "1") c->placed = true;
-			else c->placed = false;
-			std::string index;
-			std::getline(ss, index, splitChar);
-			int n = std::stoi(index);
-			for(int i = 0; i < n - 1; i++){
-				std::string id;
-				std::getline(ss, id, splitChar);
-				std::cout << id << std::endl;
-				Filter* f = GetFilterById(id);
-				c->filters.push_back(f);
+		else if(parsingFilters || parsingCombinations){
+			if(!SplitRecord(line, fields) || !(parsingFilters ? ParseFilter(fields) : ParseCombination(fields))){
+				LOG_WARNING_VALUE("Database > LoadText > Invalid record on line", lineNumber);
+				errors++;
 			}
-			std::string id;
-			std::getline(ss, id, endlChar);
-			Filter* f = GetFilterById(id);
-			c->filters.push_back(f);
-
-			AddFilterCombination(c);
 		}
 		else if(line == "Filters:") parsingFilters = true;
 		else if(line == "Combinations:") parsingCombinations = true;
-		
+		else if(line.substr(0, generationLabel.size()) == generationLabel){
+			// Files written before the generation was stored hold generation 0
+			std::string_view value = line.substr(generationLabel.size());
+			std::from_chars_result result = std::from_chars(value.data(), value.data() + value.size(), loadedGeneration);
+			if(result.ec != std::errc() || result.ptr != value.data() + value.size()){
+				LOG_WARNING_VALUE("Database > LoadText > Invalid generation on line", lineNumber);
+				errors++;
+			}
+		}
+	}
+	return errors == 0 ? 0 : -1;
+}
 
+bool Database::SplitRecord(std::string_view line, std::vector<std::string_view>& fields){
+	fields.clear();
+	if(line.empty() || line.back() != endlChar) return false;
+	line.remove_suffix(1);
+	while(true){
+		size_t split = line.find(splitChar);
+		fields.push_back(line.substr(0, split));
+		if(split == std::string_view::npos) break;
+		line.remove_prefix(split + 1);
 	}
-	file.close();
-	return 0;
+	return true;
+}
+
+bool Database::ParseFilter(const std::vector<std::string_view>& fields){
+	if(fields.size() != 4) return false;
+	Filter f;
+	const char* last = fields.at(0).data() + fields.at(0).size();
+	std::from_chars_result result = std::from_chars(fields.at(0).data(), last, f.index);
+	if(result.ec != std::errc() || result.ptr != last) return false;
+	f.id = std::string(fields.at(1));
+	f.material = std::string(fields.at(2));
+	f.thickness = std::string(fields.at(3));
+	return AddFilter(f) == 0;
+}
+
+bool Database::ParseCombination(const std::vector<std::string_view>& fields){
+	if(fields.size() < 4) return false;
+	int n = 0;
+	const char* last = fields.at(3).data() + fields.at(3).size();
+	std::from_chars_result result = std::from_chars(fields.at(3).data(), last, n);
+	if(result.ec != std::errc() || result.ptr != last || n != (int)fields.size() - 4) return false;
+	Combination c;
+	c.id = std::string(fields.at(0));
+	c.name = std::string(fields.at(1));
+	c.placed = fields.at(2) == "1";
+	for(int i = 0; i < n; i++){
+		auto it = filterIndex.find(std::string(fields.at(4 + i)));
+		if(it == filterIndex.end()) return false;
+		c.filters.push_back(it->second);
+	}
+	return AddFilterCombination(c) == 0;
 }
 
 Combination* Database::GetPlacedCombination(){
-	for(int i = 0; i < (int)combinations.size(); i++){
-		if(combinations.at(i)->placed){
-			return combinations.at(i);
+	for(int i = 0; i < combinations.Capacity(); i++){
+		Combination* c = combinations.Get(i);
+		if(c != NULL && c->placed){
+			return c;
 		}
 	}
 	return NULL;
 }
 
-int Database::HasRoom(std::string id){
-	if ((int)filters.size() >= maxFilterCount || IdExists(id)) return -1;
-	return filters.size() + 1;
+int Database::HasRoom(const std::string& id){
+	if (IdExists(id)) return -1;
+	return GetFirstFreeDrawer();
+}
+
+int Database::GetFirstFreeDrawer(void){
+	int drawer = freeDrawers.empty() ? nextDrawer : *freeDrawers.begin();
+	if (drawer > maxFilterCount) return -1;
+	return drawer;
+}
+
+std::vector<const Filter*> Database::GetFiltersByMaterial(std::string material){
+	std::vector<const Filter*> result;
+	auto it = materialIndex.find(material);
+	if (it == materialIndex.end()) return result;
+	for (int i = 0; i < (int)it->second.size(); i++) {
+		result.push_back(filters.Get(it->second.at(i)));
+	}
+	return result;
+}
+
+std::vector<const Filter*> Database::GetFiltersByThickness(double minimum, double maximum){
+	std::vector<const Filter*> result;
+	auto end = thicknessIndex.upper_bound(maximum);
+	for (auto it = thicknessIndex.lower_bound(minimum); it != end; ++it) {
+		result.push_back(filters.Get(it->second));
+	}
+	return result;
+}
+
+bool Database::ParseThickness(const std::string& thickness, double* value){
+	const char* begin = thickness.c_str();
+	char* end = NULL;
+	*value = std::strtod(begin, &end);
+	return end != begin;
 }
 
-std::vector<Filter*> Database::GetFilters(void) {
-	return filters;
+bool Database::OccupyDrawer(int drawer){
+	if (drawer < 1 || drawer > maxFilterCount) return false;
+	if (drawer >= nextDrawer) {
+		for (int i = nextDrawer; i < drawer; i++) freeDrawers.insert(i);
+		nextDrawer = drawer + 1;
+		return true;
+	}
+	return freeDrawers.erase(drawer) > 0;
+}
+
+void Database::ReleaseDrawer(int drawer){
+	if (drawer != nextDrawer - 1) {
+		freeDrawers.insert(drawer);
+		return;
+	}
+	nextDrawer--;
+	while (!freeDrawers.empty() && *freeDrawers.rbegin() == nextDrawer - 1) {
+		freeDrawers.erase(nextDrawer - 1);
+		nextDrawer--;
+	}
+}
+
+void Database::IndexFilter(FilterHandle handle, const Filter& filter){
+	filterIndex[filter.id] = handle;
+	materialIndex[filter.material].push_back(handle);
+	double thickness = 0;
+	if (ParseThickness(filter.thickness, &thickness)) thicknessIndex.emplace(thickness, handle);
+}
+
+void Database::UnindexFilter(FilterHandle handle, const Filter& filter){
+	filterIndex.erase(filter.id);
+	auto material = materialIndex.find(filter.material);
+	if (material != materialIndex.end()) {
+		std::vector<FilterHandle>& handles = material->second;
+		handles.erase(std::remove(handles.begin(), handles.end(), handle), handles.end());
+		if (handles.empty()) materialIndex.erase(material);
+	}
+	double thickness = 0;
+	if (!ParseThickness(filter.thickness, &thickness)) return;
+	auto range = thicknessIndex.equal_range(thickness);
+	for (auto it = range.first; it != range.second; ++it) {
+		if (it->second == handle) {
+			thicknessIndex.erase(it);
+			break;
+		}
+	}
+}
+
+FilterView Database::GetFilters(void) const {
+	return filters.GetView();
 }
 
 int Database::GetFilterCount(void) {
-	return (int)filters.size();
+	return filters.Count();
 }
 
 int Database::GetMaxFilterCount(void) {
@@ -151,114 +664,168 @@ int Database::GetMaxFilterCount(void) {
 
 int Database::RemoveFilter(Filter* filter) {
 	if (filter == NULL) {
-		Logging::LogEvent((int)LogLevels::LogWarning, "Database > RemoveFilter > NULL pointer argument");
+		LOG_WARNING("Database > RemoveFilter > NULL pointer argument");
 		return -1;
 	}
-	RemoveFilterCombinationContaining(filter);
-	for (int i = 0; i < (int)filters.size(); i++) {
-		if (filters.at(i) == filter) {
-			filters.erase(filters.begin() + i);
-			delete filter;
-			filter = NULL;
-			return 0;
-		}
+	auto it = filterIndex.find(filter->id);
+	if (it == filterIndex.end() || filters.Get(it->second) != filter) {
+		LOG_WARNING("Database > RemoveFilter > Filter not found");
+		return -1;
 	}
-	Logging::LogEvent((int)LogLevels::LogWarning, "Database > RemoveFilter > Filter not found");
-	return -1;
+	FilterHandle handle = it->second;
+	std::unique_lock<std::shared_mutex> lock(mutex);
+	Record(JournalRecordType::RemoveFilter, {filter->id});
+	RemoveFilterCombinationContaining(handle);
+	ReleaseDrawer(filter->index);
+	UnindexFilter(handle, *filter);
+	filters.Release(handle);
+	return 0;
 }
 
-int Database::AddFilter(Filter* filter) {
-	if (filter == NULL) {
-		Logging::LogEvent((int)LogLevels::LogWarning, "Database > AddFilter > NULL argument");
+int Database::AddFilter(const Filter& filter) {
+	if (IdExists(filter.id)) {
+		LOG_DEBUG("Database > AddFilter > Filter with ID already exists");
 		return -1;
 	}
-	if ((int)filters.size() >= maxFilterCount) {
-		Logging::LogEvent((int)LogLevels::LogDebug, "Database > AddFilter > No room for new filter");
+	int drawer = filter.index;
+	if (drawer < 1 || drawer > maxFilterCount) {
+		LOG_WARNING_VALUE("Database > AddFilter > Drawer index out of range", drawer);
 		return -1;
 	}
-	if (IdExists(filter->id)) {
-		Logging::LogEvent((int)LogLevels::LogDebug, "Database > AddFilter > Filter with ID already exists");
-		return -1;
+	if (!OccupyDrawer(drawer)) {
+		drawer = GetFirstFreeDrawer();
+		if (drawer < 0) {
+			LOG_DEBUG("Database > AddFilter > No room for new filter");
+			return -1;
+		}
+		OccupyDrawer(drawer);
 	}
-	filter->index = filters.size() + 1;
-	filters.push_back(filter);
+	std::unique_lock<std::shared_mutex> lock(mutex);
+	FilterHandle handle = filters.Allocate(filter);
+	Filter* f = filters.Get(handle);
+	f->index = drawer;
+	IndexFilter(handle, *f);
+	Record(JournalRecordType::AddFilter, {std::to_string(f->index), f->id, f->material, f->thickness});
 	return 0;
 }
 
-std::vector<Combination*> Database::GetFilterCombinations(void) {
-	return combinations;
+CombinationView Database::GetFilterCombinations(void) const {
+	return combinations.GetView();
 }
 
-Combination* Database::GetFilterCombination(std::string id) {
-	for (int i = 0; i < (int)combinations.size(); i++) {
-		Combination* c = combinations.at(i);
-		if (c->id == id) {
-			return c;
-		}
-	}
-	Logging::LogEvent((int)LogLevels::LogWarning, "Database > GetFilterCombination > Combination not found");
+Combination* Database::GetFilterCombination(const std::string& id) {
+	auto it = combinationIndex.find(id);
+	if (it != combinationIndex.end()) return combinations.Get(it->second);
+	LOG_WARNING("Database > GetFilterCombination > Combination not found");
 	return NULL;
 }
 
-int Database::AddFilterCombination(Combination* combination) {
-	if (combination == NULL) {
-		Logging::LogEvent((int)LogLevels::LogWarning, "Database > AddCombination > NULL argument");
+int Database::AddFilterCombination(const Combination& combination) {
+	if (CombinationIdExists(combination.id)) {
+		LOG_WARNING("Database > AddCombination > Combination ID not unique");
 		return -1;
 	}
-	if (CombinationIdExists(combination->id)) {
-		Logging::LogEvent((int)LogLevels::LogWarning, "Database > AddCombination > Combination ID not unique");
-		return -1;
+	for (int i = 0; i < (int)combination.filters.size(); i++) {
+		if (filters.Get(combination.filters.at(i)) == NULL) {
+			LOG_WARNING("Database > AddCombination > Invalid filter handle");
+			return -1;
+		}
+	}
+	std::unique_lock<std::shared_mutex> lock(mutex);
+	CombinationHandle handle = combinations.Allocate(combination);
+	combinationIndex[combination.id] = handle;
+	for (int i = 0; i < (int)combination.filters.size(); i++) {
+		std::vector<CombinationHandle>& users = filterCombinations[combination.filters.at(i)];
+		if (users.empty() || users.back() != handle) users.push_back(handle);
+	}
+	std::vector<std::string_view> fields;
+	if (journal != NULL) {
+		fields = {combination.id, combination.name, combination.placed ? "1" : "0"};
+		for (int i = 0; i < (int)combination.filters.size(); i++) {
+			fields.push_back(filters.Get(combination.filters.at(i))->id);
+		}
 	}
-	combinations.push_back(combination);
+	Record(JournalRecordType::AddFilterCombination, fields);
 	return 0;
 }
 
-int Database::RemoveFilterCombination(std::string id) {
-	for (int i = 0; i < (int)combinations.size(); i++) {
-		Combination* c = combinations.at(i);
-		if (c->id == id) {
-			combinations.erase(combinations.begin() + i);
-			delete c;
-			return 0;
-		}
+int Database::RemoveFilterCombination(const std::string& id) {
+	auto it = combinationIndex.find(id);
+	if (it == combinationIndex.end()) {
+		LOG_WARNING("Database > RemoveFilterCombination > Combination not found");
+		return -1;
 	}
-	Logging::LogEvent((int)LogLevels::LogWarning, "Database > RemoveFilterCombination > Combination not found");
-	return -1;
+	CombinationHandle handle = it->second;
+	std::unique_lock<std::shared_mutex> lock(mutex);
+	Record(JournalRecordType::RemoveFilterCombination, {id});
+	combinationIndex.erase(it);
+	UnlinkCombination(handle, InvalidHandle);
+	combinations.Release(handle);
+	return 0;
 }
 
-Filter* Database::GetFilterById(std::string id) {
-	for (int i = 0; i < (int)filters.size(); i++) {
-		if (filters.at(i)->id == id) return filters.at(i);
-	}
-	Logging::LogEvent((int)LogLevels::LogWarning, "Database > GetFilterByID > Filter not found");
+int Database::SetCombinationPlaced(const std::string& id, bool placed) {
+	Combination* c = GetFilterCombination(id);
+	if (c == NULL) return -1;
+	if (c->placed == placed) return 0;
+	std::unique_lock<std::shared_mutex> lock(mutex);
+	c->placed = placed;
+	Record(JournalRecordType::SetCombinationPlaced, {id, placed ? "1" : "0"});
+	return 0;
+}
+
+Filter* Database::GetFilterById(const std::string& id) {
+	auto it = filterIndex.find(id);
+	if (it != filterIndex.end()) return filters.Get(it->second);
+	LOG_WARNING("Database > GetFilterByID > Filter not found");
 	return NULL;
 }
 
-void Database::RemoveFilterCombinationContaining(Filter* filter) {
-	std::vector<std::string> toBeRemoved;
-	for (int i = 0; i < (int)combinations.size(); i++) {
-		bool remove = false;
-		Combination* c = combinations.at(i);
-		for (int j = 0; j < (int)c->filters.size(); j++) {
-			if (c->filters.at(j) == filter) remove = true;
-		}
-		if (remove) toBeRemoved.push_back(c->id);
-	}
+FilterHandle Database::GetFilterHandle(const std::string& id) {
+	auto it = filterIndex.find(id);
+	if (it != filterIndex.end()) return it->second;
+	LOG_WARNING("Database > GetFilterHandle > Filter not found");
+	return InvalidHandle;
+}
+
+Filter* Database::GetFilter(FilterHandle handle) {
+	return filters.Get(handle);
+}
+
+const Filter* Database::GetFilter(FilterHandle handle) const {
+	return filters.Get(handle);
+}
+
+void Database::RemoveFilterCombinationContaining(FilterHandle filter) {
+	auto it = filterCombinations.find(filter);
+	if (it == filterCombinations.end()) return;
+	std::vector<CombinationHandle> toBeRemoved = it->second;
+	filterCombinations.erase(it);
 	for (int i = 0; i < (int)toBeRemoved.size(); i++) {
-		RemoveFilterCombination(toBeRemoved.at(i));
+		CombinationHandle handle = toBeRemoved.at(i);
+		UnlinkCombination(handle, filter);
+		combinationIndex.erase(combinations.Get(handle)->id);
+		combinations.Release(handle);
 	}
 }
 
-bool Database::IdExists(std::string id) {
-	for (int i = 0; i < (int)filters.size(); i++) {
-		if (filters.at(i)->id == id) return true;
+void Database::UnlinkCombination(CombinationHandle combination, FilterHandle skip) {
+	Combination* c = combinations.Get(combination);
+	for (int i = 0; i < (int)c->filters.size(); i++) {
+		FilterHandle f = c->filters.at(i);
+		if (f == skip) continue;
+		auto it = filterCombinations.find(f);
+		if (it == filterCombinations.end()) continue;
+		std::vector<CombinationHandle>& users = it->second;
+		users.erase(std::remove(users.begin(), users.end(), combination), users.end());
+		if (users.empty()) filterCombinations.erase(it);
 	}
-	return false;
 }
 
-bool Database::CombinationIdExists(std::string id) {
-	for (int i = 0; i < (int)combinations.size(); i++) {
-		if (combinations.at(i)->id == id) return true;
-	}
-	return false;
+bool Database::IdExists(const std::string& id) {
+	return filterIndex.count(id) > 0;
+}
+
+bool Database::CombinationIdExists(const std::string& id) {
+	return combinationIndex.count(id) > 0;
 }
\ No newline at end of file
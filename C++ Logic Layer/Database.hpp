@@ -4,13 +4,30 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
 #include <vector>
+#include <map>
+#include <set>
+#include <unordered_map>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include "Error.h"
 #include "Logging.hpp"
+#include "Slab.hpp"
+#include "DatabaseFormat.hpp"
+#include "Journal.hpp"
+
+/// \brief      Handle of a filter record in the database
+typedef int FilterHandle;
+/// \brief      Handle of a combination record in the database
+typedef int CombinationHandle;
 
 /// \brief      Struct for defining filters
 typedef struct {
@@ -25,10 +42,26 @@ typedef struct{
 	std::string id = "";
 	std::string name = "";
     bool placed = false;
-	std::vector<Filter*> filters;
+	std::vector<FilterHandle> filters;
 }Combination;
 
+/// \brief      Immutable copy of the database contents at one generation
+/// \details    Combination::filters holds positions in the filters vector of the snapshot, not handles.
+typedef struct{
+	uint64_t generation = 0;
+	std::vector<Filter> filters;
+	std::vector<Combination> combinations;
+}DatabaseSnapshot;
+
+/// \brief      Read-only range over all filters
+typedef Slab<Filter>::View FilterView;
+/// \brief      Read-only range over all filter combinations
+typedef Slab<Combination>::View CombinationView;
+
 /// \brief      Database class
+/// \details    The database is owned by one writer thread, which may use all functions. Other threads
+///             may only call GetSnapshot, GetGeneration, IsDirty and GetMaxFilterCount. Mutations hold the database lock
+///             exclusively, snapshots are built under a shared lock and published atomically.
 class Database
 {
 public:
@@ -47,27 +80,167 @@ public:
 
     /// \brief      Save database to file on disk
 	/// \pre        None
-	/// \post       File created on disk
+	/// \post       File replaced atomically in the format set with SetFormat. With a journal
+	///             opened the journal is synced instead, and compacted once it grew too large or
+	///             an append failed.
 	/// \returns    -1 on error, 0 on success
     int SaveToDisk();
 
-    /// \brief      Save database to file on disk
+    /// \brief      Load database from file on disk
 	/// \pre        None
-	/// \post       File created on disk
+	/// \post       Database filled with contents of file, format detected from file header. Invalid
+	///             records are skipped and the file is kept as rejectedFilename, so the next save
+	///             does not lose them.
 	/// \returns    -1 on error, 0 on success
     int LoadFromDisk();
 
+    /// \brief      Set format used by SaveToDisk
+	/// \pre        None
+	/// \post       Next SaveToDisk writes this format
+	/// \param[in]  format File format to write
+	/// \returns    Nothing
+    void SetFormat(DatabaseFormat format);
+
+    /// \brief      Write database to a file
+	/// \pre        None
+	/// \post       File created on disk
+	/// \param[in]  path Path of file to write
+	/// \param[in]  format File format to write
+	/// \returns    -1 on error, 0 on success
+    int ExportToFile(std::string path, DatabaseFormat format);
+
+    /// \brief      Add contents of a database file to the database
+	/// \pre        None
+	/// \post       Filters and combinations from file added, format detected from file header
+	/// \param[in]  path Path of file to read
+	/// \returns    -1 on error, 0 on success
+    int ImportFromFile(std::string path);
+
+    /// \brief      Convert a database file between text and binary format
+	/// \pre        None
+	/// \post       Destination file written in requested format
+	/// \param[in]  source Path of file to read, any format
+	/// \param[in]  destination Path of file to write
+	/// \param[in]  format File format to write
+	/// \param[in]  maxFilterCount Number of drawers of the cabinet the file belongs to
+	/// \returns    -1 on error, 0 on success
+    static int ConvertFile(std::string source, std::string destination, DatabaseFormat format, int maxFilterCount);
+
+    /// \brief      Replay the journal and record all following mutations in it
+	/// \pre        Database loaded from disk
+	/// \post       Mutations from the journal newer than the generation of the database file
+	///             applied, journal opened for appending
+	/// \param[in]  syncInterval Number of records after which the journal is fsynced
+	/// \param[in]  compactThreshold Number of journal records after which SaveToDisk compacts
+	/// \returns    -1 on error, 0 on success
+    int OpenJournal(int syncInterval, int compactThreshold);
+
+    /// \brief      Write the database file and empty the journal
+	/// \pre        None
+	/// \post       Database file replaced atomically, journal truncated
+	/// \returns    -1 on error, 0 on success
+    int Compact(void);
+
+    /// \brief      Sync appended journal records to disk
+	/// \pre        None
+	/// \post       Journal records on disk, nothing done without journal
+	/// \returns    -1 on error, 0 on success
+    int SyncJournal(void);
+
+    /// \brief      Check if the database changed since it was last loaded or saved
+	/// \pre        None
+	/// \post       Nothing
+	/// \returns    True if there are unsaved changes
+    bool IsDirty(void);
+
+    /// \brief      Check if the unsaved changes have to be written as a full snapshot
+	/// \pre        None
+	/// \post       Nothing
+	/// \returns    True if dirty and there is no working journal, or the journal reached the
+	///             compaction threshold
+    bool NeedsSnapshot(void);
+
+    /// \brief      Get generation counter, increased by every mutation
+	/// \pre        None
+	/// \post       Nothing
+	/// \returns    Current generation
+    uint64_t GetGeneration(void);
+
+    /// \brief      Get immutable copy of the database contents
+	/// \pre        None
+	/// \post       Snapshot cached until the next mutation
+	/// \returns    Snapshot of the current generation, shared with earlier callers if unchanged
+    std::shared_ptr<const DatabaseSnapshot> GetSnapshot(void);
+
+    /// \brief      Register that a snapshot has been written to the database file
+	/// \pre        Snapshot written with WriteAtomic to the database file
+	/// \post       Generation marked as saved, journal truncated if nothing changed since. After a
+	///             failed journal append the journal is truncated once the snapshot holds its records.
+	/// \param[in]  generation Generation of the written snapshot
+	/// \returns    -1 on error, 0 on success
+    int CommitSnapshot(uint64_t generation);
+
+    /// \brief      Get path of the database file
+	/// \pre        None
+	/// \post       Nothing
+	/// \returns    Path of the database file
+    std::string GetFilename(void);
+
+    /// \brief      Get format used by SaveToDisk
+	/// \pre        None
+	/// \post       Nothing
+	/// \returns    File format
+    DatabaseFormat GetFormat(void);
+
+    /// \brief      Write a snapshot to a temporary file and rename it over a database file
+	/// \pre        None
+	/// \post       File replaced atomically
+	/// \param[in]  snapshot Snapshot to write
+	/// \param[in]  path Path of file to replace
+	/// \param[in]  format File format to write
+	/// \returns    -1 on error, 0 on success
+    static int WriteAtomic(const DatabaseSnapshot& snapshot, std::string path, DatabaseFormat format);
+
 	/// \brief      Check if there is room for a new filter and check if ID already exists
 	/// \pre        None
 	/// \post       Nothing
 	/// \returns    -1 if no room, next free index otherwise
-	int HasRoom(std::string id);
+	int HasRoom(const std::string& id);
+
+	/// \brief      Get the lowest drawer that does not hold a filter
+	/// \pre        None
+	/// \post       Nothing
+	/// \returns    -1 if all drawers are in use, drawer index otherwise
+	int GetFirstFreeDrawer(void);
+
+	/// \brief      Get filters of a material
+	/// \pre        None
+	/// \post       Nothing
+	/// \param[in]  material Material to look for, exact match
+	/// \returns    Filters with this material, invalidated by adding or removing filters
+	std::vector<const Filter*> GetFiltersByMaterial(std::string material);
+
+	/// \brief      Get filters within a thickness range
+	/// \pre        None
+	/// \post       Nothing
+	/// \param[in]  minimum Lowest thickness, inclusive
+	/// \param[in]  maximum Highest thickness, inclusive
+	/// \returns    Filters ordered by thickness, filters without numeric thickness are never returned
+	std::vector<const Filter*> GetFiltersByThickness(double minimum, double maximum);
+
+	/// \brief      Parse the leading number of a thickness, as used by the thickness index
+	/// \pre        None
+	/// \post       value set if a number was found
+	/// \param[in]  thickness Thickness text
+	/// \param[out] value Parsed number
+	/// \returns    False if the text does not start with a number
+	static bool ParseThickness(const std::string& thickness, double* value);
 
     /// \brief      Get all filters
     /// \pre        None
     /// \post       Nothing
-    /// \returns    Vector containing filters (pointers)
-	std::vector<Filter*> GetFilters(void);
+    /// \returns    Read-only view on filters, invalidated by adding or removing filters
+	FilterView GetFilters(void) const;
 
 	/// \brief      Get number of filters in database
 	/// \pre        None
@@ -90,43 +263,73 @@ public:
 
     /// \brief      Add filter
     /// \pre        None
-    /// \post       Added filter information to database
-    /// \param[in]  filter Pointer to filter on HEAP
-    /// \returns    0 on success, -1 on error
-    int AddFilter(Filter* filter);
+    /// \post       Copy of filter information stored in database. The filter keeps its index if that
+    ///             drawer is free, otherwise it is placed in the first free drawer.
+    /// \param[in]  filter Filter to store, index between 1 and the maximum filter count
+    /// \returns    0 on success, -1 on error or if the index is out of range
+    int AddFilter(const Filter& filter);
 
     /// \brief      Get filter combinations
     /// \pre        None
     /// \post       Nothing
-    /// \returns	Vector with filter combinations (pointers)
-	std::vector<Combination*> GetFilterCombinations(void);
+    /// \returns	Read-only view on filter combinations, invalidated by adding or removing combinations
+	CombinationView GetFilterCombinations(void) const;
 
 	/// \brief      Get filter combination by id
 	/// \pre        None
 	/// \post       Nothing
 	/// \returns	Filter combination pointer
-	Combination* GetFilterCombination(std::string id);
+	Combination* GetFilterCombination(const std::string& id);
+
+	/// \brief      Mark filter combination as placed or removed
+	/// \pre        None
+	/// \post       Placed state of combination updated
+	/// \param[in]  id ID of combination
+	/// \param[in]  placed True if the combination is placed in the cabinet
+	/// \returns    0 on success, -1 on error
+	int SetCombinationPlaced(const std::string& id, bool placed);
 
     /// \brief      Add filter combination
     /// \pre        None
-    /// \post       Added filter combination to database
-    /// \param[in]  combination Pointer to filter combination on HEAP
+    /// \post       Copy of filter combination stored in database
+    /// \param[in]  combination Filter combination to store
     /// \returns    0 on success, -1 on error
-    int AddFilterCombination(Combination* combination);
+    int AddFilterCombination(const Combination& combination);
 
     /// \brief      Remove filter combination
     /// \pre        None
     /// \post       Removed filter combination to database
     /// \param[in]  id ID to remove
     /// \returns    0 on success, -1 on error
-    int RemoveFilterCombination(std::string id);
+    int RemoveFilterCombination(const std::string& id);
 
 	/// \brief      Get filter by unique ID
 	/// \pre        None
 	/// \post       Nothing
 	/// \param[in]  id ID of filter to return
 	/// \returns    Filter pointer on success, NULL otherwise
-	Filter* GetFilterById(std::string id);
+	Filter* GetFilterById(const std::string& id);
+
+	/// \brief      Get handle of filter by unique ID
+	/// \pre        None
+	/// \post       Nothing
+	/// \param[in]  id ID of filter
+	/// \returns    Filter handle on success, InvalidHandle otherwise
+	FilterHandle GetFilterHandle(const std::string& id);
+
+	/// \brief      Get filter by handle
+	/// \pre        None
+	/// \post       Nothing
+	/// \param[in]  handle Handle of filter, as stored in Combination::filters
+	/// \returns    Filter pointer on success, NULL otherwise
+	Filter* GetFilter(FilterHandle handle);
+
+	/// \brief      Get filter by handle
+	/// \pre        None
+	/// \post       Nothing
+	/// \param[in]  handle Handle of filter, as stored in Combination::filters
+	/// \returns    Filter pointer on success, NULL otherwise
+	const Filter* GetFilter(FilterHandle handle) const;
 
     /// \brief      Get placed filter combination
 	/// \pre        None
@@ -137,18 +340,89 @@ public:
 private:
 	/// \brief      Number of filters that can be physically stored
 	int maxFilterCount;
-    /// \brief      List for storing drawer information
-    std::vector<Filter*> filters;
-    /// \brief      List for storing filter combinations
-    std::vector<Combination*> combinations;
+    /// \brief      Storage for drawer information
+    Slab<Filter> filters;
+    /// \brief      Storage for filter combinations
+    Slab<Combination> combinations;
+	/// \brief      Index of filters by unique ID, kept in sync with filters
+	std::unordered_map<std::string, FilterHandle> filterIndex;
+	/// \brief      Index of combinations by unique ID, kept in sync with combinations
+	std::unordered_map<std::string, CombinationHandle> combinationIndex;
+	/// \brief      Index of filters by material
+	std::unordered_map<std::string, std::vector<FilterHandle>> materialIndex;
+	/// \brief      Index of filters by numeric thickness
+	std::multimap<double, FilterHandle> thicknessIndex;
+	/// \brief      Free drawers below nextDrawer
+	std::set<int> freeDrawers;
+	/// \brief      Lowest drawer above all used drawers
+	int nextDrawer = 1;
+	/// \brief      Mark drawer as used, false if it is out of range or already used
+	bool OccupyDrawer(int drawer);
+	/// \brief      Mark drawer as free
+	void ReleaseDrawer(int drawer);
+	/// \brief      Add filter to the id, material and thickness indexes
+	void IndexFilter(FilterHandle handle, const Filter& filter);
+	/// \brief      Remove filter from the id, material and thickness indexes
+	void UnindexFilter(FilterHandle handle, const Filter& filter);
+	/// \brief      Reverse index from filter to the combinations referencing it
+	std::unordered_map<FilterHandle, std::vector<CombinationHandle>> filterCombinations;
 	/// \brief      Remove all filter combinations containing this filter
-	void RemoveFilterCombinationContaining(Filter* filter);
+	void RemoveFilterCombinationContaining(FilterHandle filter);
+	/// \brief      Remove combination from the reverse index of its member filters
+	void UnlinkCombination(CombinationHandle combination, FilterHandle skip);
 	/// \brief      Check if another filter is already on this id
-	bool IdExists(std::string id);
+	bool IdExists(const std::string& id);
 	/// \brief      Check if another combination is already on this id
-	bool CombinationIdExists(std::string id);
+	bool CombinationIdExists(const std::string& id);
+	/// \brief      Write text format file
+	static int SaveText(const DatabaseSnapshot& snapshot, std::string path);
+	/// \brief      Write binary format file
+	static int SaveBinary(const DatabaseSnapshot& snapshot, std::string path);
+	/// \brief      Read text format file
+	int LoadText(std::string path);
+	/// \brief      Read binary format file through mmap, copying its strings into the database
+	int LoadBinary(std::string path);
+	/// \brief      Continue the generation counter at the generation of the loaded file
+	void AdoptFileGeneration(void);
+	/// \brief      Split a text format record into fields, false if the record is not terminated
+	bool SplitRecord(std::string_view line, std::vector<std::string_view>& fields);
+	/// \brief      Add filter from text format fields, false if the fields are invalid or the filter is not added
+	bool ParseFilter(const std::vector<std::string_view>& fields);
+	/// \brief      Add combination from text format fields, false if the fields are invalid or a member is unknown
+	bool ParseCombination(const std::vector<std::string_view>& fields);
+	/// \brief      Count a mutation and append it to the journal if one is opened
+	void Record(JournalRecordType type, const std::vector<std::string_view>& fields);
+	/// \brief      Count a mutation and append it to the journal if one is opened
+	void Record(JournalRecordType type, std::initializer_list<std::string_view> fields);
+	/// \brief      Apply a mutation read from the journal
+	void ApplyRecord(JournalRecordType type, const std::vector<std::string>& fields);
+	/// \brief      Journal of mutations since last compaction, NULL if not journaling
+	Journal* journal = NULL;
+	/// \brief      Number of journal records after which SaveToDisk compacts
+	int compactThreshold = 0;
+	/// \brief      Generation of the mutation a journal append failed for, 0 while journaling works.
+	///             No records are appended until a snapshot of the current generation is committed.
+	uint64_t journalFailedGeneration = 0;
+	/// \brief      Mutation counter
+	std::atomic<uint64_t> generation{0};
+	/// \brief      Generation last written to or read from the database file
+	std::atomic<uint64_t> savedGeneration{0};
+	/// \brief      Generation stored in the last file read, 0 for files without one
+	uint64_t loadedGeneration = 0;
+	/// \brief      Cached snapshot, rebuilt when the generation changed. Accessed with atomic_load and atomic_store.
+	std::shared_ptr<const DatabaseSnapshot> snapshot;
+	/// \brief      Held exclusively by mutations and shared while building a snapshot
+	std::shared_mutex mutex;
     /// \brief      Filename and path for persistent database
 	const std::string filename = "database.txt";
+    /// \brief      Start of the text format line holding the generation of the file
+	const std::string generationLabel = "Generation: ";
+    /// \brief      Filename and path for journal of the persistent database
+	const std::string journalFilename = "database.journal";
+    /// \brief      Filename and path for a database file that had invalid records
+	const std::string rejectedFilename = "database.txt.rejected";
+	/// \brief      Format written by SaveToDisk
+	DatabaseFormat format = DatabaseFormat::Text;
     /// \brief      Char for splitting strings
 	const char splitChar = ',';
     /// \brief      Char for ending lines
@@ -0,0 +1,58 @@
+/// \file       DatabaseFormat.hpp
+/// \brief      Header file for the binary database file layout
+///             The binary file consists of a header, fixed size record tables and a string pool.
+///             All values are stored in host byte order, the file is meant to be read back on the
+///             same target. Loading reads the fixed size records in place instead of splitting
+///             text lines, the strings are still copied into the database.
+
+#pragma once
+
+#include <cstdint>
+
+/// \brief      File formats supported by the database
+enum class DatabaseFormat {
+	Text,           ///< Line oriented text file, readable by hand
+	Binary          ///< Fixed size record tables and string pool, see DatabaseFileHeader
+};
+
+/// \brief      Magic bytes at the start of a binary database file
+static const char DatabaseMagic[4] = {'F', 'U', 'D', 'B'};
+/// \brief      Version of the binary layout, increase when changing any record struct
+static const uint32_t DatabaseVersion = 2;
+
+/// \brief      Reference to a string in the string pool
+struct DatabaseString {
+	uint32_t offset;            ///< Offset from start of string pool
+	uint32_t length;            ///< Length in bytes, not terminated
+};
+
+/// \brief      Header at the start of a binary database file
+/// \details    The header is followed by filterCount DatabaseFilterRecords, combinationCount
+///             DatabaseCombinationRecords, memberCount uint32_t member entries and the string pool.
+///             A member entry is the position of the member in the filter record table.
+struct DatabaseFileHeader {
+	char magic[4];              ///< DatabaseMagic
+	uint32_t version;           ///< DatabaseVersion
+	uint32_t filterCount;       ///< Number of filter records
+	uint32_t combinationCount;  ///< Number of combination records
+	uint32_t memberCount;       ///< Number of combination member entries
+	uint32_t stringPoolSize;    ///< Size of string pool in bytes
+	uint64_t generation;        ///< Database generation of the contents, journal records up to it are included
+};
+
+/// \brief      Filter record in a binary database file
+struct DatabaseFilterRecord {
+	int32_t index;
+	DatabaseString id;
+	DatabaseString material;
+	DatabaseString thickness;
+};
+
+/// \brief      Combination record in a binary database file
+struct DatabaseCombinationRecord {
+	DatabaseString id;
+	DatabaseString name;
+	uint32_t placed;            ///< 1 if placed, 0 otherwise
+	uint32_t firstMember;       ///< First entry in the member table
+	uint32_t memberCount;       ///< Number of entries in the member table
+};
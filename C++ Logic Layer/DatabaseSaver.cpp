@@ -0,0 +1,86 @@
+/// \file      DatabaseSaver.cpp
+
+#include "DatabaseSaver.hpp"
+
+#include <chrono>
+#include <sys/stat.h>
+
+DatabaseSaver::DatabaseSaver(std::string path, DatabaseFormat format){
+	this->path = path;
+	this->format = format;
+	running = false;
+	submittedGeneration = 0;
+	writtenGeneration = 0;
+}
+
+DatabaseSaver::~DatabaseSaver(void){
+	Stop();
+}
+
+void DatabaseSaver::Start(void){
+	std::lock_guard<std::mutex> lock(mutex);
+	if(running) return;
+	running = true;
+	thread = std::thread(&DatabaseSaver::Loop, this);
+}
+
+void DatabaseSaver::Stop(void){
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+	}
+	condition.notify_one();
+	if(thread.joinable()) thread.join();
+}
+
+void DatabaseSaver::Submit(std::shared_ptr<const DatabaseSnapshot> snapshot){
+	if(snapshot == NULL) return;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pending = snapshot;
+	}
+	submittedGeneration = snapshot->generation;
+	condition.notify_one();
+}
+
+uint64_t DatabaseSaver::GetWrittenGeneration(void){
+	return writtenGeneration;
+}
+
+uint64_t DatabaseSaver::GetSubmittedGeneration(void){
+	return submittedGeneration;
+}
+
+SaverStatistics DatabaseSaver::GetStatistics(void){
+	std::lock_guard<std::mutex> lock(mutex);
+	return statistics;
+}
+
+void DatabaseSaver::Loop(void){
+	std::unique_lock<std::mutex> lock(mutex);
+	while(true){
+		condition.wait(lock, [this] { return pending != NULL || !running; });
+		if(pending == NULL) break;
+		std::shared_ptr<const DatabaseSnapshot> snapshot = pending;
+		pending = NULL;
+		lock.unlock();
+
+		auto start = std::chrono::steady_clock::now();
+		int ret = Database::WriteAtomic(*snapshot, path, format);
+		uint64_t duration = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+		struct stat info;
+		uint64_t bytes = (ret == 0 && stat(path.c_str(), &info) == 0) ? (uint64_t)info.st_size : 0;
+		if(ret == 0) writtenGeneration = snapshot->generation;
+
+		lock.lock();
+		if(ret < 0){
+			statistics.failedCount++;
+			continue;
+		}
+		statistics.snapshotCount++;
+		statistics.lastDurationUs = duration;
+		if(duration > statistics.maxDurationUs) statistics.maxDurationUs = duration;
+		statistics.lastBytesWritten = bytes;
+		statistics.totalBytesWritten += bytes;
+	}
+}
@@ -0,0 +1,107 @@
+/// \file       DatabaseSaver.hpp
+/// \brief      Header file for the background database saver
+///             DatabaseSaver writes database snapshots to disk on its own thread so the control loop
+///             never waits for file I/O.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "Database.hpp"
+
+/// \brief      Counters of the background saver
+typedef struct {
+	uint64_t snapshotCount = 0;         ///< Number of snapshots written
+	uint64_t failedCount = 0;           ///< Number of snapshots that could not be written
+	uint64_t lastDurationUs = 0;        ///< Duration of the last write in microseconds
+	uint64_t maxDurationUs = 0;         ///< Longest write in microseconds
+	uint64_t lastBytesWritten = 0;      ///< Size of the last written file
+	uint64_t totalBytesWritten = 0;     ///< Bytes written by all snapshots
+}SaverStatistics;
+
+/// \brief      Background thread writing database snapshots
+class DatabaseSaver
+{
+public:
+	/// \brief      Constructor
+	/// \pre        None
+	/// \post       Saver created, thread not started
+	/// \param[in]  path Path of database file to replace
+	/// \param[in]  format File format to write
+	/// \returns    Nothing
+	DatabaseSaver(std::string path, DatabaseFormat format);
+
+	/// \brief      Destructor
+	/// \pre        None
+	/// \post       Pending snapshot written and thread stopped
+	/// \returns    Nothing
+	~DatabaseSaver(void);
+
+	/// \brief      Start saver thread
+	/// \pre        None
+	/// \post       Thread running
+	/// \returns    Nothing
+	void Start(void);
+
+	/// \brief      Stop saver thread after writing a pending snapshot
+	/// \pre        None
+	/// \post       Thread stopped
+	/// \returns    Nothing
+	void Stop(void);
+
+	/// \brief      Queue a snapshot for writing, replaces a snapshot that has not been started yet
+	/// \pre        Thread started
+	/// \post       Saver thread woken up
+	/// \param[in]  snapshot Snapshot to write
+	/// \returns    Nothing
+	void Submit(std::shared_ptr<const DatabaseSnapshot> snapshot);
+
+	/// \brief      Get generation of the last snapshot written to disk
+	/// \pre        None
+	/// \post       Nothing
+	/// \returns    Generation, 0 if nothing was written yet
+	uint64_t GetWrittenGeneration(void);
+
+	/// \brief      Get generation of the last snapshot submitted
+	/// \pre        None
+	/// \post       Nothing
+	/// \returns    Generation, 0 if nothing was submitted yet
+	uint64_t GetSubmittedGeneration(void);
+
+	/// \brief      Get saver counters
+	/// \pre        None
+	/// \post       Nothing
+	/// \returns    Copy of the counters
+	SaverStatistics GetStatistics(void);
+
+private:
+	/// \brief      Path of database file
+	std::string path;
+	/// \brief      Format of database file
+	DatabaseFormat format;
+	/// \brief      Saver thread
+	std::thread thread;
+	/// \brief      Protects pending, running and statistics
+	std::mutex mutex;
+	/// \brief      Signals a new snapshot or stop request
+	std::condition_variable condition;
+	/// \brief      Snapshot waiting to be written
+	std::shared_ptr<const DatabaseSnapshot> pending;
+	/// \brief      False when the thread has to stop
+	bool running;
+	/// \brief      Generation of the last submitted snapshot
+	std::atomic<uint64_t> submittedGeneration;
+	/// \brief      Generation of the last written snapshot
+	std::atomic<uint64_t> writtenGeneration;
+	/// \brief      Counters, protected by mutex
+	SaverStatistics statistics;
+
+	/// \brief      Thread function
+	void Loop(void);
+};
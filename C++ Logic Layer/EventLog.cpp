@@ -0,0 +1,96 @@
+/// \file       EventLog.cpp
+
+#include "EventLog.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <string>
+
+std::mutex EventLog::mutex;
+RingBuffer<EventRecord, EVENTLOG_CAPACITY> EventLog::events;
+uint64_t EventLog::lastSequence = 0;
+std::unordered_map<const char*, uint16_t> EventLog::codes;
+size_t EventLog::imported = 0;
+
+uint64_t EventLog::Add(uint64_t timeUs, LogLevels level, const char* message, int64_t argument, bool hasArgument){
+    std::lock_guard<std::mutex> lock(mutex);
+    EventRecord event;
+    event.timeUs = timeUs;
+    event.message = message;
+    event.argument = argument;
+    event.level = level;
+    event.hasArgument = hasArgument;
+    auto code = codes.find(message);
+    if (code != codes.end()) {
+        event.code = code->second;
+    }
+    else if (codes.size() < EVENTLOG_MAX_CODES) {
+        event.code = (uint16_t)(codes.size() + 1);
+        codes.emplace(message, event.code);
+    }
+    uint64_t sequence = Store(event);
+    // The tag lets Import skip the event however Logging decorates or filters its entries
+    Logging::LogEvent((int)level, EVENTLOG_TAG + std::to_string(sequence) + " " + Format(event));
+    return sequence;
+}
+
+void EventLog::Import(void){
+    // Copied without the mutex so Add and Read do not wait for it
+    std::vector<std::string> history = Logging::GetEvents();
+    std::lock_guard<std::mutex> lock(mutex);
+    // A shorter history has been cleared, start at its beginning
+    if (history.size() < imported) imported = 0;
+    uint64_t now = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    for (size_t i = imported; i < history.size(); i++) {
+        if (IsTagged(history.at(i))) continue;
+        EventRecord event;
+        event.timeUs = now;
+        event.text = history.at(i);
+        Store(event);
+    }
+    imported = history.size();
+}
+
+uint64_t EventLog::Read(uint64_t since, int maximum, std::vector<EventRecord>& result){
+    std::lock_guard<std::mutex> lock(mutex);
+    if (events.Empty() || since >= lastSequence) return since;
+    // Sequence numbers of stored events are consecutive and end at lastSequence, so the offset
+    // of the first one after since is below events.Size()
+    uint64_t first = events.Front().sequence;
+    int position = (since < first) ? 0 : (int)(since - first + 1);
+    uint64_t next = since;
+    for (; position < events.Size() && maximum > 0; position++, maximum--) {
+        result.push_back(events.At(position));
+        next = events.At(position).sequence;
+    }
+    return next;
+}
+
+std::string EventLog::Format(const EventRecord& event){
+    std::string text = (event.message != NULL) ? event.message : event.text;
+    if (event.hasArgument) text += " " + std::to_string(event.argument);
+    return text;
+}
+
+uint64_t EventLog::Store(EventRecord& event){
+    event.sequence = ++lastSequence;
+    if (events.Free() == 0) events.Pop();
+    events.Push(event);
+    return event.sequence;
+}
+
+bool EventLog::IsTagged(const std::string& entry){
+    // Logging may put a time or level in front, the tag is followed by a known sequence number
+    size_t tag = entry.find(EVENTLOG_TAG);
+    while (tag != std::string::npos) {
+        size_t digits = tag + sizeof(EVENTLOG_TAG) - 1;
+        size_t end = digits;
+        while (end < entry.size() && entry[end] >= '0' && entry[end] <= '9') end++;
+        if (end > digits && end < entry.size() && entry[end] == ' ' && end - digits < 20 &&
+            std::strtoull(entry.c_str() + digits, NULL, 10) <= lastSequence) {
+            return true;
+        }
+        tag = entry.find(EVENTLOG_TAG, tag + 1);
+    }
+    return false;
+}
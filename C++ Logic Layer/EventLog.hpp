@@ -0,0 +1,101 @@
+/// \file       EventLog.hpp
+/// \brief      Header file for the in-memory event history
+///             EventLog keeps the last EVENTLOG_CAPACITY log events as binary records. Every event
+///             gets a sequence number so clients can page through the history and fetch new events.
+///             Events logged by other components through Logging are imported into the same history.
+///             Logging only hands out a copy of its whole history, so the import runs on the FastLog
+///             flusher thread every EVENTLOG_IMPORT_INTERVAL_MS and never when the history is read.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Logging.hpp"
+#include "RingBuffer.hpp"
+
+/// \brief      Number of events kept, older events are overwritten
+#define EVENTLOG_CAPACITY 4096
+/// \brief      Number of distinct messages that get their own event code
+#define EVENTLOG_MAX_CODES 1024
+/// \brief      Interval at which the flusher thread imports the Logging history
+#define EVENTLOG_IMPORT_INTERVAL_MS 1000
+/// \brief      Tag in front of the events passed to Logging, followed by the sequence number
+#define EVENTLOG_TAG "EventLog#"
+
+/// \brief      Stored log event
+typedef struct {
+    uint64_t sequence = 0;              ///< Sequence number, starts at 1 and increments per event
+    uint64_t timeUs = 0;                ///< Time the event was logged, microseconds since epoch
+    const char* message = NULL;         ///< String literal of the event, NULL for imported events
+    std::string text;                   ///< Text of an event imported from Logging
+    int64_t argument = 0;               ///< Number appended to the message
+    uint16_t code = 0;                  ///< Number of the message, 0 if the code table is full
+    LogLevels level = LogLevels::LogDebug;  ///< Level of the event
+    bool hasArgument = false;           ///< True if argument is appended
+}EventRecord;
+
+/// \brief      Bounded history of log events
+/// \details    Event codes are handed out per message literal in order of first use, so they
+///             are stable while the process runs. Stored events are passed on to Logging tagged
+///             with EVENTLOG_TAG and their sequence number. Import adds the untagged events of the
+///             Logging history with code 0, level LogDebug and the time of the import. All
+///             functions may be called from any thread.
+class EventLog
+{
+public:
+    /// \brief      Store an event
+    /// \pre        message points to a string literal
+    /// \post       Event stored with the next sequence number, oldest event dropped if full. Tagged
+    ///             event passed to Logging::LogEvent.
+    /// \param[in]  timeUs Time the event was logged
+    /// \param[in]  level Level of the event
+    /// \param[in]  message Message of the event
+    /// \param[in]  argument Number appended to the message
+    /// \param[in]  hasArgument True if argument is appended
+    /// \returns    Sequence number of the event
+    static uint64_t Add(uint64_t timeUs, LogLevels level, const char* message, int64_t argument, bool hasArgument);
+
+    /// \brief      Store the events other components logged through Logging since the last import
+    /// \pre        Not called when serving a client, copies the whole Logging history
+    /// \post       Foreign events of the Logging history stored with the next sequence numbers
+    /// \returns    Nothing
+    static void Import(void);
+
+    /// \brief      Get stored events after a sequence number
+    /// \pre        None
+    /// \post       Up to maximum events appended to events, oldest first
+    /// \param[in]  since Sequence number of the last event the caller has, 0 for the oldest
+    /// \param[in]  maximum Maximum number of events to return
+    /// \param[out] events Returned events
+    /// \returns    Sequence number to pass as since for the next page
+    static uint64_t Read(uint64_t since, int maximum, std::vector<EventRecord>& events);
+
+    /// \brief      Format an event as text
+    /// \pre        None
+    /// \post       Nothing
+    /// \param[in]  event Event to format
+    /// \returns    Message with the argument appended
+    static std::string Format(const EventRecord& event);
+
+private:
+    /// \brief      Protects all members
+    static std::mutex mutex;
+    /// \brief      Stored events, oldest first
+    static RingBuffer<EventRecord, EVENTLOG_CAPACITY> events;
+    /// \brief      Sequence number of the last stored event
+    static uint64_t lastSequence;
+    /// \brief      Event code per message literal
+    static std::unordered_map<const char*, uint16_t> codes;
+    /// \brief      Number of Logging history entries already imported
+    static size_t imported;
+
+    /// \brief      Store an event with the next sequence number, mutex held
+    static uint64_t Store(EventRecord& event);
+    /// \brief      True if a Logging history entry is an event passed by Add
+    static bool IsTagged(const std::string& entry);
+};
@@ -0,0 +1,127 @@
+/// \file       FastLog.cpp
+
+#include "FastLog.hpp"
+#include "EventLog.hpp"
+
+#include <chrono>
+#include <string>
+
+// A slot is free for position p when its sequence is 2 * (p / FASTLOG_CAPACITY) and holds the
+// record of p when it is one higher, so zero initialized slots are free for the first lap.
+FastLog::Slot FastLog::slots[FASTLOG_CAPACITY];
+std::atomic<uint64_t> FastLog::writePosition{0};
+uint64_t FastLog::readPosition = 0;
+std::atomic<uint64_t> FastLog::dropped{0};
+std::atomic<uint64_t> FastLog::flushed{0};
+std::mutex FastLog::flushMutex;
+std::condition_variable FastLog::wakeup;
+std::thread FastLog::flusher;
+bool FastLog::running = false;
+
+/// \brief      Sequence of a free slot for a position
+static uint64_t FreeSequence(uint64_t position){
+    return 2 * (position / FASTLOG_CAPACITY);
+}
+
+bool FastLog::Write(FastLogKind kind, LogLevels level, const char* message, int64_t argument, bool hasArgument){
+    uint64_t position = writePosition.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+        slot = &slots[position & (FASTLOG_CAPACITY - 1)];
+        int64_t difference = (int64_t)slot->sequence.load(std::memory_order_acquire) - (int64_t)FreeSequence(position);
+        if (difference == 0) {
+            if (writePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+        }
+        else if (difference < 0) {
+            // Slot still holds a record of the previous lap, the ring buffer is full
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else {
+            position = writePosition.load(std::memory_order_relaxed);
+        }
+    }
+    slot->record.timeUs = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    slot->record.message = message;
+    slot->record.argument = argument;
+    slot->record.level = level;
+    slot->record.kind = kind;
+    slot->record.hasArgument = hasArgument;
+    slot->sequence.store(FreeSequence(position) + 1, std::memory_order_release);
+    return true;
+}
+
+void FastLog::Start(void){
+    std::lock_guard<std::mutex> lock(flushMutex);
+    if (running) return;
+    running = true;
+    flusher = std::thread(&FastLog::FlushLoop);
+}
+
+void FastLog::Stop(void){
+    {
+        std::lock_guard<std::mutex> lock(flushMutex);
+        running = false;
+    }
+    wakeup.notify_one();
+    if (flusher.joinable()) flusher.join();
+    Flush();
+}
+
+int FastLog::Flush(void){
+    std::lock_guard<std::mutex> lock(flushMutex);
+    return Drain();
+}
+
+void FastLog::SetLevel(int level){
+    runtimeLevel.store(level, std::memory_order_relaxed);
+}
+
+FastLogStatistics FastLog::GetStatistics(void){
+    FastLogStatistics statistics;
+    statistics.flushed = flushed.load(std::memory_order_relaxed);
+    statistics.dropped = dropped.load(std::memory_order_relaxed);
+    statistics.written = writePosition.load(std::memory_order_relaxed);
+    return statistics;
+}
+
+void FastLog::FlushLoop(void){
+    std::unique_lock<std::mutex> lock(flushMutex);
+    auto lastImport = std::chrono::steady_clock::now();
+    while (running) {
+        // Writers never signal, the flusher polls so writing stays free of locks and syscalls
+        wakeup.wait_for(lock, std::chrono::milliseconds(FASTLOG_FLUSH_INTERVAL_MS), [] { return !running; });
+        Drain();
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastImport >= std::chrono::milliseconds(EVENTLOG_IMPORT_INTERVAL_MS)) {
+            // Flush() callers do not wait for the copy of the Logging history
+            lock.unlock();
+            EventLog::Import();
+            lock.lock();
+            lastImport = now;
+        }
+    }
+}
+
+int FastLog::Drain(void){
+    int count = 0;
+    while (true) {
+        Slot& slot = slots[readPosition & (FASTLOG_CAPACITY - 1)];
+        uint64_t free = FreeSequence(readPosition);
+        if (slot.sequence.load(std::memory_order_acquire) != free + 1) break;
+        FastLogRecord record = slot.record;
+        slot.sequence.store(free + 2, std::memory_order_release);
+        readPosition++;
+
+        if (record.kind == FastLogKind::ENTER) {
+            Logging::LogEnterFunction(record.message, "");
+        }
+        else {
+            // EventLog passes the event on to Logging
+            EventLog::Add(record.timeUs, record.level, record.message, record.argument, record.hasArgument);
+        }
+        count++;
+    }
+    flushed.fetch_add(count, std::memory_order_relaxed);
+    return count;
+}
@@ -0,0 +1,167 @@
+/// \file       FastLog.hpp
+/// \brief      Header file for the hot path logging front end
+///             FastLog stores log records in a preallocated lock-free ring buffer. A background
+///             thread stores events in the EventLog history, passes records to Logging and imports the
+///             events other components logged through Logging into EventLog. Levels below
+///             FASTLOG_COMPILE_LEVEL are removed at compile time, the runtime level costs one branch.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "Logging.hpp"
+
+/// \brief      Function entry records, replaces Logging::LogEnterFunction
+#define FASTLOG_LEVEL_TRACE 0
+/// \brief      Debug events
+#define FASTLOG_LEVEL_DEBUG 1
+/// \brief      Warnings
+#define FASTLOG_LEVEL_WARNING 2
+/// \brief      Errors
+#define FASTLOG_LEVEL_ERROR 3
+/// \brief      Nothing is logged
+#define FASTLOG_LEVEL_OFF 4
+
+/// \brief      Lowest level compiled in, records below it generate no code
+#ifndef FASTLOG_COMPILE_LEVEL
+#define FASTLOG_COMPILE_LEVEL FASTLOG_LEVEL_DEBUG
+#endif
+/// \brief      Number of records the ring buffer holds, power of two
+#define FASTLOG_CAPACITY 1024
+/// \brief      Interval at which the flusher thread drains the ring buffer
+#define FASTLOG_FLUSH_INTERVAL_MS 20
+
+/// \brief      Write a record if its level is compiled in and enabled
+/// \details    message has to be a string literal, it is stored by pointer
+#define FASTLOG(rank, kind, level, message, argument, hasArgument) \
+    do { \
+        if constexpr ((rank) >= FASTLOG_COMPILE_LEVEL) { \
+            if ((rank) >= FastLog::runtimeLevel.load(std::memory_order_relaxed)) \
+                FastLog::Write((kind), (level), (message), (int64_t)(argument), (hasArgument)); \
+        } \
+    } while (0)
+
+/// \brief      Log entry of the current function
+#define LOG_ENTER() FASTLOG(FASTLOG_LEVEL_TRACE, FastLogKind::ENTER, LogLevels::LogDebug, __FUNCTION__, 0, false)
+/// \brief      Log a debug event
+#define LOG_DEBUG(message) FASTLOG(FASTLOG_LEVEL_DEBUG, FastLogKind::EVENT, LogLevels::LogDebug, message, 0, false)
+/// \brief      Log a debug event with a number appended
+#define LOG_DEBUG_VALUE(message, value) FASTLOG(FASTLOG_LEVEL_DEBUG, FastLogKind::EVENT, LogLevels::LogDebug, message, value, true)
+/// \brief      Log a warning
+#define LOG_WARNING(message) FASTLOG(FASTLOG_LEVEL_WARNING, FastLogKind::EVENT, LogLevels::LogWarning, message, 0, false)
+/// \brief      Log a warning with a number appended
+#define LOG_WARNING_VALUE(message, value) FASTLOG(FASTLOG_LEVEL_WARNING, FastLogKind::EVENT, LogLevels::LogWarning, message, value, true)
+/// \brief      Log an error
+#define LOG_ERROR(message) FASTLOG(FASTLOG_LEVEL_ERROR, FastLogKind::EVENT, LogLevels::LogError, message, 0, false)
+
+/// \brief      Kind of log record
+enum class FastLogKind : uint8_t
+{
+    EVENT,                      ///< Passed to Logging::LogEvent
+    ENTER                       ///< Passed to Logging::LogEnterFunction
+};
+
+/// \brief      Log record as stored in the ring buffer
+typedef struct {
+    uint64_t timeUs;                    ///< Time of writing, microseconds since epoch
+    const char* message;                ///< String literal, function name for ENTER records
+    int64_t argument;                   ///< Number appended to the message
+    LogLevels level;                    ///< Level passed to Logging
+    FastLogKind kind;                   ///< Kind of record
+    bool hasArgument;                   ///< True if argument is appended
+}FastLogRecord;
+
+/// \brief      Counters of the logging front end
+typedef struct {
+    uint64_t written = 0;               ///< Records stored in the ring buffer
+    uint64_t dropped = 0;               ///< Records lost because the ring buffer was full
+    uint64_t flushed = 0;               ///< Records passed to Logging
+}FastLogStatistics;
+
+/// \brief      Lock-free logging front end
+/// \details    Any thread may write, a full ring buffer drops the record instead of blocking.
+///             Records written before Start() are kept until the flusher runs.
+class FastLog
+{
+public:
+    /// \brief      Lowest level written at runtime
+    inline static std::atomic<int> runtimeLevel{FASTLOG_LEVEL_DEBUG};
+
+    /// \brief      Store a record in the ring buffer
+    /// \pre        message points to a string literal
+    /// \post       Record stored, or counted as dropped if the ring buffer is full
+    /// \param[in]  kind Kind of record
+    /// \param[in]  level Level passed to Logging
+    /// \param[in]  message Message or function name
+    /// \param[in]  argument Number appended to the message
+    /// \param[in]  hasArgument True if argument is appended
+    /// \returns    True on success, false if the record was dropped
+    static bool Write(FastLogKind kind, LogLevels level, const char* message, int64_t argument, bool hasArgument);
+
+    /// \brief      Start the flusher thread
+    /// \pre        None
+    /// \post       Flusher running, does nothing if it already runs
+    /// \returns    Nothing
+    static void Start(void);
+
+    /// \brief      Stop the flusher thread
+    /// \pre        None
+    /// \post       Flusher stopped, all stored records passed to Logging
+    /// \returns    Nothing
+    static void Stop(void);
+
+    /// \brief      Pass all stored records to Logging on the calling thread
+    /// \pre        None, serialized with the flusher by flushMutex
+    /// \post       Ring buffer empty
+    /// \returns    Number of records passed
+    static int Flush(void);
+
+    /// \brief      Set the lowest level written at runtime
+    /// \pre        None
+    /// \post       Records below level are not written
+    /// \param[in]  level One of the FASTLOG_LEVEL values
+    /// \returns    Nothing
+    static void SetLevel(int level);
+
+    /// \brief      Get the counters
+    /// \pre        None
+    /// \post       Nothing
+    /// \returns    Copy of the counters
+    static FastLogStatistics GetStatistics(void);
+
+private:
+    /// \brief      Ring buffer slot, sequence tells producers and the consumer whose turn it is
+    typedef struct {
+        std::atomic<uint64_t> sequence;
+        FastLogRecord record;
+    }Slot;
+
+    static_assert((FASTLOG_CAPACITY & (FASTLOG_CAPACITY - 1)) == 0, "FASTLOG_CAPACITY must be a power of two");
+
+    /// \brief      Record slots
+    static Slot slots[FASTLOG_CAPACITY];
+    /// \brief      Position of the next record to write
+    static std::atomic<uint64_t> writePosition;
+    /// \brief      Position of the next record to flush, only used by the flushing thread
+    static uint64_t readPosition;
+    /// \brief      Counters
+    static std::atomic<uint64_t> dropped;
+    static std::atomic<uint64_t> flushed;
+    /// \brief      Protects the flusher thread and serializes Flush()
+    static std::mutex flushMutex;
+    /// \brief      Wakes the flusher when it has to stop
+    static std::condition_variable wakeup;
+    /// \brief      Flusher thread
+    static std::thread flusher;
+    /// \brief      True while the flusher runs
+    static bool running;
+
+    /// \brief      Body of the flusher thread
+    static void FlushLoop(void);
+    /// \brief      Pass stored records to Logging, flushMutex held
+    static int Drain(void);
+};
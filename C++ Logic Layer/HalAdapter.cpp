@@ -0,0 +1,72 @@
+/// \file       HalAdapter.cpp
+
+#include "HalAdapter.hpp"
+
+#include <cstddef>
+
+HalAdapter::HalAdapter(void){
+    hal = new Hal();
+    openDrawers = 0;
+    drawersKnown = false;
+}
+
+HalAdapter::~HalAdapter(void){
+    delete hal;
+    hal = NULL;
+}
+
+void HalAdapter::init(void){
+    hal->init();
+    drawersKnown = false;
+}
+
+void HalAdapter::de_init(void){
+    hal->de_init();
+}
+
+void HalAdapter::run(void){
+    hal->run();
+}
+
+HalStatus HalAdapter::getStatus(void){
+    switch(hal->getState()){
+        case HalStates::BUSY:
+            return HalStatus::BUSY;
+        case HalStates::ERROR:
+            return HalStatus::ERROR;
+        default:
+            return HalStatus::IDLE;
+    }
+}
+
+void HalAdapter::openDrawer(int drawer){
+    hal->openDrawer(drawer);
+    if (drawer >= 0 && drawer < 64) openDrawers |= (uint64_t)1 << drawer;
+    else drawersKnown = false;
+}
+
+int HalAdapter::closeDrawer(int drawer){
+    int ret = hal->closeDrawer(drawer);
+    if (ret == 0 && drawer >= 0 && drawer < 64) openDrawers &= ~((uint64_t)1 << drawer);
+    return ret;
+}
+
+void HalAdapter::closeAllDrawers(void){
+    if (!drawersKnown) {
+        IHal::closeAllDrawers();
+        openDrawers = 0;
+        drawersKnown = true;
+        return;
+    }
+    for (int drawer = 0; drawer < 64; drawer++) {
+        if (openDrawers & ((uint64_t)1 << drawer)) closeDrawer(drawer);
+    }
+}
+
+void HalAdapter::setMagnet(int state){
+    hal->setMagnet(state);
+}
+
+void HalAdapter::moveCrane(int position){
+    hal->moveCrane(position);
+}
@@ -0,0 +1,45 @@
+/// \file       HalAdapter.hpp
+/// \brief      Header file for the cabinet HAL adapter
+///             HalAdapter implements IHal on top of the Hal class of the cabinet.
+
+#pragma once
+
+#include "IHal.hpp"
+#include "hal.hpp"
+
+/// \brief      IHal implementation forwarding to the cabinet Hal
+/// \details    The adapter remembers which drawers it extended. Until all drawers have been
+///             retracted once after init(), closeAllDrawers() retracts every drawer.
+class HalAdapter : public IHal
+{
+public:
+    /// \brief      Constructor
+    /// \pre        None
+    /// \post       Adapter owning a new Hal object
+    /// \returns    Nothing
+    HalAdapter(void);
+
+    /// \brief      Destructor
+    /// \pre        None
+    /// \post       Hal object deleted
+    /// \returns    Nothing
+    ~HalAdapter(void);
+
+    void init(void) override;
+    void de_init(void) override;
+    void run(void) override;
+    HalStatus getStatus(void) override;
+    void openDrawer(int drawer) override;
+    int closeDrawer(int drawer) override;
+    void closeAllDrawers(void) override;
+    void setMagnet(int state) override;
+    void moveCrane(int position) override;
+
+private:
+    /// \brief      Cabinet hardware
+    Hal* hal;
+    /// \brief      Bit per drawer extended through this adapter
+    uint64_t openDrawers;
+    /// \brief      False if drawers may be extended that are not in openDrawers
+    bool drawersKnown;
+};
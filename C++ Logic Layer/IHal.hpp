@@ -0,0 +1,104 @@
+/// \file       IHal.hpp
+/// \brief      Header file for the HAL interface
+///             IHal is the hardware interface used by Logic and Step, implemented by HalAdapter for
+///             the cabinet and by SimHal for running without hardware.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+/// \brief      State of a HAL as polled by Logic::Run
+enum class HalStatus
+{
+    IDLE,                       ///< Ready for the next operation
+    BUSY,                       ///< Executing an operation
+    ERROR                       ///< Operation failed, init() has to be called to recover
+};
+
+/// \brief      Resource bit of the crane
+static const uint64_t HalResourceCrane = 1;
+/// \brief      Resource bit of the magnet
+static const uint64_t HalResourceMagnet = 2;
+/// \brief      Resource bits of all drawers
+static const uint64_t HalResourceDrawers = ~(uint64_t)3;
+/// \brief      All resource bits
+static const uint64_t HalResourceAll = ~(uint64_t)0;
+/// \brief      Highest drawer with its own resource bit, higher drawers share the bit of this drawer
+static const int HalResourceMaxDrawer = 61;
+
+/// \brief      Get resource bit of a drawer
+/// \param[in]  drawer Drawer number
+/// \returns    Resource bit
+inline uint64_t HalResourceDrawer(int drawer) {
+    if (drawer < 0) drawer = 0;
+    if (drawer > HalResourceMaxDrawer) drawer = HalResourceMaxDrawer;
+    return (uint64_t)4 << drawer;
+}
+
+/// \brief      Interface to the cabinet hardware
+/// \details    Operations start an action and return immediately, getStatus() reports BUSY until
+///             the action has finished. run() has to be called regularly to update the state.
+///             HALs that track resources run operations on different resources at the same time,
+///             an operation on a busy resource starts when the resource is free.
+class IHal
+{
+public:
+    /// \brief      Destructor
+    virtual ~IHal(void) {}
+
+    /// \brief      Initialize hardware, clears an error state
+    virtual void init(void) = 0;
+
+    /// \brief      Stop hardware
+    virtual void de_init(void) = 0;
+
+    /// \brief      Update state of running operations
+    virtual void run(void) = 0;
+
+    /// \brief      Set function called when the state changes without a call from Logic
+    /// \details    Implementations that can only be polled ignore the callback.
+    /// \param[in]  callback Function to call, may be called from any thread
+    virtual void setStatusCallback(std::function<void(void)> callback) { (void)callback; }
+
+    /// \brief      Get state of the hardware
+    /// \returns    Current state
+    virtual HalStatus getStatus(void) = 0;
+
+    /// \brief      Check if reports per resource are available
+    /// \details    If false, isBusy() only reflects the global state and getStatus() may lag until
+    ///             the next run(), so only one operation is started per run().
+    /// \returns    True if isBusy() reports the state of single resources right after an operation is started
+    virtual bool tracksResources(void) { return false; }
+
+    /// \brief      Check if any of the given resources is busy
+    /// \param[in]  resources Resource bits to check
+    /// \returns    True if one of the resources is executing an operation
+    virtual bool isBusy(uint64_t resources) { (void)resources; return getStatus() == HalStatus::BUSY; }
+
+    /// \brief      Extend a drawer
+    /// \param[in]  drawer Drawer to extend
+    virtual void openDrawer(int drawer) = 0;
+
+    /// \brief      Retract a drawer
+    /// \param[in]  drawer Drawer to retract
+    /// \returns    0 on success, non zero if the drawer does not exist
+    virtual int closeDrawer(int drawer) = 0;
+
+    /// \brief      Retract all extended drawers
+    /// \details    The default retracts every drawer one by one until closeDrawer() reports a drawer
+    ///             that does not exist. Implementations that know which drawers are extended only
+    ///             retract those, as one command if the hardware supports it.
+    virtual void closeAllDrawers(void) {
+        int drawer = 0;
+        while (closeDrawer(drawer) == 0) drawer++;
+    }
+
+    /// \brief      Switch the magnet
+    /// \param[in]  state 1 for on, 0 for off
+    virtual void setMagnet(int state) = 0;
+
+    /// \brief      Move the crane
+    /// \param[in]  position Target position
+    virtual void moveCrane(int position) = 0;
+};
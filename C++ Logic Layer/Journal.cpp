@@ -0,0 +1,194 @@
+/// \file      Journal.cpp
+
+#include "Journal.hpp"
+#include "FastLog.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <fcntl.h>
+#include <unistd.h>
+
+/// \brief      Size of payload length and checksum in front of each record
+static const size_t recordHeaderSize = 2 * sizeof(uint32_t);
+
+/// \brief      FNV-1a checksum over a record payload
+static uint32_t Checksum(const char* data, size_t size){
+	uint32_t hash = 2166136261u;
+	for(size_t i = 0; i < size; i++){
+		hash ^= (uint8_t)data[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/// \brief      Append a value in host byte order
+template <typename T>
+static void Put(std::string& buffer, T value){
+	buffer.append((const char*)&value, sizeof(T));
+}
+
+/// \brief      Read a value in host byte order, returns false if not enough data is left
+template <typename T>
+static bool Get(const char*& data, const char* end, T& value){
+	if((size_t)(end - data) < sizeof(T)) return false;
+	std::memcpy(&value, data, sizeof(T));
+	data += sizeof(T);
+	return true;
+}
+
+Journal::Journal(std::string path, int syncInterval){
+	this->path = path;
+	this->syncInterval = syncInterval;
+	fd = -1;
+	pending = 0;
+	recordCount = 0;
+	validSize = -1;
+	size = 0;
+	failed = false;
+}
+
+Journal::~Journal(void){
+	if(fd < 0) return;
+	Sync();
+	close(fd);
+}
+
+int Journal::Replay(ReplayHandler handler){
+	std::ifstream file;
+	file.open(path, std::ifstream::binary);
+	if(!file.is_open()){
+		// No journal yet, nothing to replay
+		validSize = 0;
+		return 0;
+	}
+	std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	file.close();
+
+	const char* begin = contents.data();
+	const char* end = begin + contents.size();
+	const char* data = begin;
+	int count = 0;
+	std::vector<std::string> fields;
+	while(data < end){
+		const char* record = data;
+		uint32_t length = 0;
+		uint32_t checksum = 0;
+		if(!Get(data, end, length) || !Get(data, end, checksum)) break;
+		if((size_t)(end - data) < length || Checksum(data, length) != checksum) break;
+
+		const char* payloadEnd = data + length;
+		uint8_t type = 0;
+		uint64_t generation = 0;
+		uint16_t fieldCount = 0;
+		bool valid = Get(data, payloadEnd, type) && Get(data, payloadEnd, generation) && Get(data, payloadEnd, fieldCount);
+		fields.clear();
+		for(uint16_t i = 0; i < fieldCount && valid; i++){
+			uint32_t size = 0;
+			valid = Get(data, payloadEnd, size) && (size_t)(payloadEnd - data) >= size;
+			if(valid){
+				fields.emplace_back(data, size);
+				data += size;
+			}
+		}
+		if(!valid){
+			data = record;
+			break;
+		}
+		data = payloadEnd;
+		handler((JournalRecordType)type, generation, fields);
+		count++;
+	}
+	if(data < end) LOG_WARNING("Journal > Replay > Dropped incomplete record at end of journal");
+	validSize = (long)(data - begin);
+	recordCount = count;
+	return count;
+}
+
+int Journal::Open(void){
+	if(fd >= 0) return 0;
+	fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+	if(fd < 0){
+		LOG_WARNING("Journal > Open > Unable to open file");
+		return -1;
+	}
+	if(validSize >= 0 && ftruncate(fd, validSize) < 0){
+		LOG_WARNING("Journal > Open > Unable to drop incomplete record");
+	}
+	size = validSize >= 0 ? validSize : (long)lseek(fd, 0, SEEK_END);
+	return 0;
+}
+
+int Journal::Append(JournalRecordType type, uint64_t generation, const std::vector<std::string_view>& fields){
+	if(fd < 0){
+		LOG_WARNING("Journal > Append > Journal not opened");
+		return -1;
+	}
+	if(failed) return -1;
+	buffer.assign(recordHeaderSize, '\0');
+	Put(buffer, (uint8_t)type);
+	Put(buffer, generation);
+	Put(buffer, (uint16_t)fields.size());
+	for(int i = 0; i < (int)fields.size(); i++){
+		Put(buffer, (uint32_t)fields.at(i).size());
+		buffer += fields.at(i);
+	}
+	uint32_t length = (uint32_t)(buffer.size() - recordHeaderSize);
+	uint32_t checksum = Checksum(buffer.data() + recordHeaderSize, length);
+	std::memcpy(&buffer[0], &length, sizeof(length));
+	std::memcpy(&buffer[sizeof(length)], &checksum, sizeof(checksum));
+
+	const char* data = buffer.data();
+	size_t left = buffer.size();
+	while(left > 0){
+		ssize_t written = write(fd, data, left);
+		if(written < 0 && errno == EINTR) continue;
+		if(written <= 0){
+			// Later records must not follow torn bytes, cut the partial record off and stop appending
+			if(ftruncate(fd, size) < 0) LOG_WARNING("Journal > Append > Unable to remove partial record");
+			failed = true;
+			LOG_WARNING("Journal > Append > Write error");
+			return -1;
+		}
+		data += written;
+		left -= (size_t)written;
+	}
+	size += (long)buffer.size();
+	recordCount++;
+	pending++;
+	if(pending >= syncInterval) return Sync();
+	return 0;
+}
+
+int Journal::Sync(void){
+	if(fd < 0) return -1;
+	if(pending == 0) return 0;
+	if(fdatasync(fd) < 0){
+		LOG_WARNING("Journal > Sync > fsync failed");
+		return -1;
+	}
+	pending = 0;
+	return 0;
+}
+
+int Journal::Truncate(void){
+	if(fd < 0) return -1;
+	if(ftruncate(fd, 0) < 0 || fdatasync(fd) < 0){
+		LOG_WARNING("Journal > Truncate > Unable to truncate file");
+		return -1;
+	}
+	pending = 0;
+	recordCount = 0;
+	size = 0;
+	failed = false;
+	return 0;
+}
+
+int Journal::GetRecordCount(void){
+	return recordCount;
+}
+
+bool Journal::IsFailed(void){
+	return failed;
+}
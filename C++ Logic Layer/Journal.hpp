@@ -0,0 +1,116 @@
+/// \file       Journal.hpp
+/// \brief      Header file for the database journal
+///             Journal appends database mutations to a file so the database file only needs to be
+///             rewritten on compaction. Records are fsynced in batches.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// \brief      Types of mutations stored in the journal
+enum class JournalRecordType : uint8_t {
+	AddFilter = 1,                  ///< index, id, material, thickness
+	RemoveFilter = 2,               ///< id
+	AddFilterCombination = 3,       ///< id, name, placed, member filter ids
+	RemoveFilterCombination = 4,    ///< id
+	SetCombinationPlaced = 5        ///< id, placed
+};
+
+/// \brief      Append-only journal of database mutations
+/// \details    Each record is stored as payload length, checksum, type, generation, field count
+///             and length prefixed fields. The generation is the database generation the mutation
+///             created, replay skips records the database file already holds. A record with a bad length or checksum ends replay, which
+///             drops a partially written record after a crash. A failed append cuts the partial
+///             record off and stops the journal until it is truncated, so no record is ever
+///             appended behind a missing one.
+class Journal
+{
+public:
+	/// \brief      Handler called for every record during replay
+	typedef std::function<void(JournalRecordType type, uint64_t generation, const std::vector<std::string>& fields)> ReplayHandler;
+
+	/// \brief      Constructor
+	/// \pre        None
+	/// \post       Journal object created, file not opened
+	/// \param[in]  path Path of journal file
+	/// \param[in]  syncInterval Number of appended records after which the file is fsynced
+	/// \returns    Nothing
+	Journal(std::string path, int syncInterval);
+
+	/// \brief      Destructor
+	/// \pre        None
+	/// \post       Pending records synced and file closed
+	/// \returns    Nothing
+	~Journal(void);
+
+	/// \brief      Read all complete records from the journal file
+	/// \pre        Journal not opened for appending
+	/// \post       Handler called for each record in order
+	/// \param[in]  handler Function applying a record
+	/// \returns    Number of records replayed, -1 on error
+	int Replay(ReplayHandler handler);
+
+	/// \brief      Open journal file for appending
+	/// \pre        None
+	/// \post       File opened, created if it does not exist. A torn record at the end is cut off.
+	/// \returns    0 on success, -1 on error
+	int Open(void);
+
+	/// \brief      Append a record
+	/// \pre        Journal opened
+	/// \post       Record written, file synced if syncInterval records are pending. On a write error
+	///             the file is cut back to the last complete record and the journal is failed.
+	/// \param[in]  type Type of mutation
+	/// \param[in]  generation Database generation after the mutation
+	/// \param[in]  fields Fields of the mutation
+	/// \returns    0 on success, -1 on error or if the journal is failed
+	int Append(JournalRecordType type, uint64_t generation, const std::vector<std::string_view>& fields);
+
+	/// \brief      Sync pending records to disk
+	/// \pre        Journal opened
+	/// \post       All appended records are on disk
+	/// \returns    0 on success, -1 on error
+	int Sync(void);
+
+	/// \brief      Remove all records, used after the database file has been compacted
+	/// \pre        Journal opened
+	/// \post       Empty journal file, no longer failed
+	/// \returns    0 on success, -1 on error
+	int Truncate(void);
+
+	/// \brief      Check if an append failed since the last truncate
+	/// \pre        None
+	/// \post       Nothing
+	/// \returns    True if records are refused until Truncate
+	bool IsFailed(void);
+
+	/// \brief      Get number of records in the journal file
+	/// \pre        None
+	/// \post       Nothing
+	/// \returns    Number of records replayed and appended since the last truncate
+	int GetRecordCount(void);
+
+private:
+	/// \brief      Path of journal file
+	std::string path;
+	/// \brief      File descriptor, -1 if not opened
+	int fd;
+	/// \brief      Number of appended records after which the file is fsynced
+	int syncInterval;
+	/// \brief      Number of records not yet synced
+	int pending;
+	/// \brief      Number of records in the file
+	int recordCount;
+	/// \brief      Size of the complete records found by Replay
+	long validSize;
+	/// \brief      Size of the complete records in the file
+	long size;
+	/// \brief      True after a failed append until the next truncate
+	bool failed;
+	/// \brief      Buffer for encoding records, reused between appends
+	std::string buffer;
+};
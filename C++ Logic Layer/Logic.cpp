@@ -1,389 +1,803 @@
 /// \file       Logic.cpp
 
 #include "Logic.hpp"
-#include <sstream>
+#include <chrono>
+#include <cstdlib>
+#include <limits>
 #include <iostream>
 #include <vector>
 
 #define MAX_DRAWER 4
+#define JOURNAL_SYNC_INTERVAL 8
+#define JOURNAL_COMPACT_THRESHOLD 256
+#define MAX_STEPS_PER_TASK (8 * MAX_DRAWER + 4)
+static_assert(STEP_GROUP_CAPACITY >= MAX_STEPS_PER_TASK + 2, "Step group can not hold a task and its restore steps");
+static_assert(Recipes::CombinationPrologue.size() + MAX_DRAWER * Recipes::PlaceFilter.size() + Recipes::PlaceEpilogue.size() + 1 <= MAX_STEPS_PER_TASK, "PLACECOMBINATION does not fit in a step group");
+static_assert(Recipes::CombinationPrologue.size() + MAX_DRAWER * Recipes::RemoveFilter.size() + 1 <= MAX_STEPS_PER_TASK, "REMOVECOMBINATION does not fit in a step group");
+#define HAL_POLL_INTERVAL_MS 10
+#define STEP_BUDGET_PER_TICK 16
+#define SYSTEMLOG_PAGE_SIZE 32
+#define SYSTEMLOG_MAX_PAGE_SIZE 256
 
 Logic::Logic(IQueueHandler* queueHandler){
-    Logging::LogEnterFunction(__FUNCTION__, "");
+    LOG_ENTER();
     this->queueHandler = queueHandler;
-    hal = new Hal();
+    hal = new HalAdapter();
+    ownsHal = true;
+    Init();
+}
+
+Logic::Logic(IQueueHandler* queueHandler, IHal* hal){
+    LOG_ENTER();
+    this->queueHandler = queueHandler;
+    this->hal = hal;
+    ownsHal = false;
+    Init();
+}
+
+void Logic::Init(void){
+    FastLog::Start();
+    metrics = new Metrics();
     hal->init();
+    stepBudget = STEP_BUDGET_PER_TICK;
+    hal->setStatusCallback([this](void) {
+        {
+            std::lock_guard<std::mutex> lock(eventMutex);
+            halChanged = true;
+        }
+        wakeup.notify_one();
+    });
 	database = new Database(MAX_DRAWER);
 	database->LoadFromDisk();
+	database->OpenJournal(JOURNAL_SYNC_INTERVAL, JOURNAL_COMPACT_THRESHOLD);
+	saver = new DatabaseSaver(database->GetFilename(), database->GetFormat());
+	saver->Start();
 	placedCombination = NULL;
 }
 
 Logic::~Logic(void){
-    Logging::LogEnterFunction(__FUNCTION__, "");
+    LOG_ENTER();
     hal->de_init();
-    delete hal;
+    hal->setStatusCallback(NULL);
+    if (ownsHal) delete hal;
     hal = NULL;
+	saver->Stop();
+	database->CommitSnapshot(saver->GetWrittenGeneration());
+	delete saver;
 	delete database;
+    delete metrics;
+    FastLog::Stop();
 }
 
 void Logic::Run(void){
-    Logging::LogEnterFunction(__FUNCTION__, "");
+    LOG_ENTER();
+    RunSteps();
+}
+
+void Logic::RunEventLoop(void){
+    LOG_ENTER();
+    std::unique_lock<std::mutex> lock(eventMutex);
+    stopRequested = false;
+    eventMode = true;
+    while (!stopRequested) {
+        while (!inbox.empty()) {
+            ReceivedTask received = std::move(inbox.front());
+            inbox.pop_front();
+            lock.unlock();
+            taskToStep(std::move(received.task), received.received);
+            lock.lock();
+        }
+        halChanged = false;
+        lock.unlock();
+        bool ran = RunSteps() > 0;
+        bool busy = hal->getStatus() == HalStatus::BUSY;
+        if (!ran && !busy && queue.Empty()) Save();
+        lock.lock();
+        if (ran) continue;
 
+        auto ready = [this](void) { return stopRequested || !inbox.empty() || halChanged; };
+        if (busy) wakeup.wait_for(lock, std::chrono::milliseconds(HAL_POLL_INTERVAL_MS), ready);
+        else if (queue.Empty() || hal->getStatus() == HalStatus::ERROR) wakeup.wait(lock, ready);
+    }
+    // Tasks that arrived while stopping are converted with the lock held. callback waits for the
+    // lock and then finds eventMode false, so taskToStep never runs on two threads at once.
+    while (!inbox.empty()) {
+        ReceivedTask received = std::move(inbox.front());
+        inbox.pop_front();
+        taskToStep(std::move(received.task), received.received);
+    }
+    eventMode = false;
+}
+
+void Logic::StopEventLoop(void){
+    {
+        std::lock_guard<std::mutex> lock(eventMutex);
+        stopRequested = true;
+    }
+    wakeup.notify_one();
+}
+
+int Logic::RunSteps(void){
     hal->run();
+    FinishTimedSteps();
+    metrics->SampleHal(hal->getStatus() == HalStatus::BUSY);
 
-    if (hal->getState() == HalStates::ERROR){
-		Logging::LogEvent((int)LogLevels::LogError, "Logic > Run > Hal error state");
-        return;
+    if (hal->getStatus() == HalStatus::ERROR && !halFailed){
+        // HALs without resource tracking report the error of a started operation after run()
+		LOG_ERROR("Logic > Run > Hal error state");
+        halFailed = true;
+        FailRunning();
+    }
+	if(queue.Empty()) return 0;
+
+    int count = 0;
+    bool waitingForHAL = false;
+    // Without resource tracking the HAL state is only reliable after run(), start one operation per tick
+    while (!(waitingForHAL && !hal->tracksResources()) && count < stepBudget) {
+        Step* s = queue.Next(IsSafePoint());
+        if (s == NULL) {
+            // A task that can not be resumed is failed, the next group may still run
+            CancelledTask failed;
+            if (!queue.CancelFailed(&failed)) break;
+            FailTask(failed);
+            continue;
+        }
+        if ((halStopped || halFailed) && s->MovesCabinet()) {
+            // The cabinet can not move until RESET starts the HAL again
+            FailRunning();
+            continue;
+        }
+        // Steps start in order, a step waits only for the resources it depends on. A failed HAL
+        // does not finish its operations, RESET and return messages do not wait for it.
+        if (!halFailed && hal->isBusy(s->GetWaitResources())) break;
+		LOG_DEBUG("Logic > Run > Next step");
+        waitingForHAL = s->DoStep(*hal, *database, *queueHandler);
+        if (hal->getStatus() == HalStatus::ERROR && !halFailed) {
+            // HALs with resource tracking fail when the operation is started, stop the batch here
+            LOG_ERROR("Logic > Run > Hal error state");
+            halFailed = true;
+            FailRunning();
+            break;
+        }
+        if(waitingForHAL) {
+            LOG_DEBUG("Logic > Run > Waiting for hal");
+            TimeStep(*s);
+        }
+        TrackState(*s);
+        if (s->GetType() == StepType::STOP_HAL) {
+            // Tasks interrupted by STOP can not continue, the cabinet state they left is lost
+            CancelledTask cancelled;
+            while (queue.CancelInterrupted(&cancelled)) FailTask(cancelled);
+        }
+        StepCompletion completion;
+        queue.Pop(&completion);
+        if (completion.responseSent) {
+            runStatistics.responseCount++;
+            runStatistics.totalResponseLatencyUs += completion.responseLatencyUs;
+            if (completion.responseLatencyUs > runStatistics.maxResponseLatencyUs) runStatistics.maxResponseLatencyUs = completion.responseLatencyUs;
+        }
+        if (completion.taskDone) metrics->CommandDone(completion.command, completion.queueUs, completion.totalUs);
+        count++;
     }
-	else if(queue.empty() || hal->getState() == HalStates::BUSY) return;
+    metrics->SampleHal(hal->getStatus() == HalStatus::BUSY);
+    metrics->SampleQueue(queue.StepCount(), STEP_GROUP_COUNT - queue.FreeGroups());
+    runStatistics.tickCount++;
+    runStatistics.stepCount += count;
+    if ((uint64_t)count > runStatistics.maxStepsPerTick) runStatistics.maxStepsPerTick = count;
+    return count;
+}
 
-	Logging::LogEvent((int)LogLevels::LogDebug, "Logic > Run > Next step");
+void Logic::SetStepBudget(int budget){
+    stepBudget = budget < 1 ? 1 : budget;
+}
 
-    Step* s = queue.front();
-	queue.pop();
-    bool waitingForHAL = s->DoStep(*hal, *database, *queueHandler);
-    if(waitingForHAL) Logging::LogEvent((int)LogLevels::LogDebug, "Logic > Run > Waiting for hal");
-    delete s;
-    s = NULL;
+RunStatistics Logic::GetRunStatistics(void){
+    return runStatistics;
 }
 
 void Logic::Save(void){
-	database->SaveToDisk();
+	database->CommitSnapshot(saver->GetWrittenGeneration());
+	// Journaled changes only need a snapshot once the journal grew past JOURNAL_COMPACT_THRESHOLD
+	if (database->NeedsSnapshot() && saver->GetSubmittedGeneration() != database->GetGeneration()) {
+		saver->Submit(database->GetSnapshot());
+	}
+	database->SyncJournal();
+}
+
+SaverStatistics Logic::GetSaverStatistics(void){
+	return saver->GetStatistics();
+}
+
+OptimizerStatistics Logic::GetOptimizerStatistics(void){
+	return optimizer.GetStatistics();
+}
+
+std::string Logic::DumpMetrics(void){
+    return metrics->Dump();
+}
+
+void Logic::TimeStep(const Step& step){
+    for (int i = 0; i < METRICS_TIMED_STEPS; i++) {
+        if (timedSteps[i].used) continue;
+        timedSteps[i].used = true;
+        timedSteps[i].type = step.GetType();
+        timedSteps[i].resources = step.GetWaitResources();
+        timedSteps[i].started = std::chrono::steady_clock::now();
+        return;
+    }
+}
+
+void Logic::FinishTimedSteps(void){
+    auto now = std::chrono::steady_clock::now();
+    for (int i = 0; i < METRICS_TIMED_STEPS; i++) {
+        if (!timedSteps[i].used || hal->isBusy(timedSteps[i].resources)) continue;
+        metrics->StepDone(timedSteps[i].type, (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(now - timedSteps[i].started).count());
+        timedSteps[i].used = false;
+    }
 }
 
 void Logic::callback(Task task){
-    Logging::LogEnterFunction(__FUNCTION__, "");
-    taskToStep(task);
+    LOG_ENTER();
+    auto received = std::chrono::steady_clock::now();
+    if (AnswerQuery(task)) {
+        uint64_t elapsed = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - received).count();
+        metrics->CommandDone(task.GetCommand(), elapsed, elapsed);
+        return;
+    }
+    if (eventMode) {
+        {
+            std::lock_guard<std::mutex> lock(eventMutex);
+            if (eventMode) {
+                inbox.push_back(ReceivedTask{std::move(task), received});
+                metrics->SampleInbox((int)inbox.size());
+                wakeup.notify_one();
+                return;
+            }
+        }
+    }
+    taskToStep(std::move(task), received);
+}
+
+bool Logic::AnswerQuery(Task& task){
+    TaskCommandEnum command = task.GetCommand();
+    int slot;
+    switch (command){
+        case TaskCommandEnum::GETFILTERS:
+			LOG_DEBUG("Logic > Received task > GETFILTERS");
+            slot = 0;
+            break;
+        case TaskCommandEnum::GETFILTERCOMBINATIONS:
+			LOG_DEBUG("Logic > Received task > GETFILTERCOMBINATIONS");
+            slot = 1;
+            break;
+        case TaskCommandEnum::GETSYSTEMSTATUS:
+			LOG_DEBUG("Logic > Received task > GETSYSTEMSTATUS");
+            slot = 2;
+            break;
+        default:
+            return false;
+    }
+
+    // Reuse the last response until a mutation changes the database generation
+    std::shared_ptr<const CachedResponse> cached = std::atomic_load(&queryCache[slot]);
+    if (cached == NULL || cached->generation != database->GetGeneration()) {
+        cached = BuildQueryResponse(command);
+        std::atomic_store(&queryCache[slot], cached);
+    }
+    ResponseBuilder response(task);
+    for (const std::string& parameter : cached->parameters) {
+        response.Add(parameter);
+    }
+    response.Send(*queueHandler);
+    return true;
+}
+
+std::shared_ptr<const CachedResponse> Logic::BuildQueryResponse(TaskCommandEnum command){
+    std::shared_ptr<const DatabaseSnapshot> snapshot = database->GetSnapshot();
+    std::shared_ptr<CachedResponse> built = std::make_shared<CachedResponse>();
+    built->generation = snapshot->generation;
+    std::vector<std::string>& parameters = built->parameters;
+    parameters.push_back(std::to_string((int)Resultcodes::Success));
+    switch (command){
+        case TaskCommandEnum::GETFILTERS:
+			for (const Filter& f : snapshot->filters) {
+				parameters.push_back(f.id);
+				parameters.push_back(f.material);
+				parameters.push_back(f.thickness);
+			}
+			break;
+        case TaskCommandEnum::GETFILTERCOMBINATIONS:
+			for (const Combination& c : snapshot->combinations) {
+				parameters.push_back(c.id);
+				parameters.push_back(c.name);
+				parameters.push_back(c.placed ? "true" : "false");
+				parameters.push_back(std::to_string(c.filters.size()));
+				for (int j = 0; j < (int)c.filters.size(); j++) {
+					parameters.push_back(snapshot->filters.at(c.filters.at(j)).id);
+				}
+			}
+			break;
+        default:
+            parameters.push_back("Nominal");
+            parameters.push_back("1.0");
+            parameters.push_back(std::to_string(database->GetMaxFilterCount() - (int)snapshot->filters.size()));
+            break;
+    }
+    return built;
+}
+
+
+
+bool Logic::HasStepRoom(TaskCommandEnum command){
+    switch (command){
+        case TaskCommandEnum::ADDFILTER:
+        case TaskCommandEnum::REQUESTADDFILTER:
+        case TaskCommandEnum::CANCELADDFILTER:
+        case TaskCommandEnum::REMOVEFILTER:
+        case TaskCommandEnum::REQUESTREMOVEFILTER:
+        case TaskCommandEnum::CANCELREMOVEFILTER:
+        case TaskCommandEnum::PLACECOMBINATION:
+        case TaskCommandEnum::REMOVECOMBINATION:
+        case TaskCommandEnum::STOP:
+        case TaskCommandEnum::RESET:
+            return queue.FreeGroups() > 0;
+        default:
+            return true;
+    }
+}
+
+void Logic::TrackState(const Step& step){
+    switch (step.GetType()){
+        case StepType::CRANE_MOVE:
+            craneState = step.GetParam();
+            break;
+        case StepType::MAGNET:
+            magnetState = step.GetParam();
+            break;
+        case StepType::DRAWER_EXTEND:
+            drawersClosed = false;
+            break;
+        case StepType::ALL_DRAWERS_RETRACT:
+            drawersClosed = true;
+            break;
+        case StepType::STOP_HAL:
+        case StepType::START_HAL:
+            craneState = -1;
+            magnetState = -1;
+            drawersClosed = false;
+            halStopped = step.GetType() == StepType::STOP_HAL;
+            halFailed = false;
+            break;
+        default:
+            break;
+    }
+}
+
+bool Logic::IsSafePoint(void){
+    return craneState == CRANE_HOME && magnetState == magnetOff && drawersClosed;
+}
+
+void Logic::QueueStep(Step step){
+    switch (optimizer.Check(step, !queue.OpenEmpty())){
+        case StepAction::DROP:
+            return;
+        case StepAction::REPLACE_LAST:
+            queue.Back() = step;
+            return;
+        case StepAction::KEEP:
+            if (!queue.Push(step)) LOG_ERROR("Logic > QueueStep > Step group full");
+            return;
+    }
+}
+
+template <std::size_t Size>
+void Logic::QueueRecipe(const StepRecipe<Size>& recipe, const RecipeContext& context){
+    for (const RecipeStep& step : recipe) {
+        QueueStep(Step(step.type, ResolveRecipeStep(step, context)));
+    }
+}
+
+RecipeContext Logic::GetRecipeContext(int drawer, int slot){
+    RecipeContext context;
+    context.home = CRANE_HOME;
+    context.intake = cranePositions[0];
+    context.drawer = drawer;
+    context.drawerPosition = cranePositions[drawer];
+    context.slotPosition = cranePositions[0] - (slot * stackPitch);
+    return context;
+}
+
+void Logic::QueueResponse(Task&& response){
+    Task* pending = queue.PushResponse(std::move(response));
+    if (pending == NULL) {
+        LOG_ERROR("Logic > QueueResponse > No room for response");
+        return;
+    }
+    QueueStep(Step(StepType::SEND_RETURN_MESSAGE, pending));
 }
 
+void Logic::FailRunning(void){
+    CancelledTask cancelled;
+    if (queue.CancelRunning(&cancelled)) FailTask(cancelled);
+}
 
+void Logic::FailTask(CancelledTask& cancelled){
+    LOG_WARNING_VALUE("Logic > FailTask > Task cancelled, command", (int)cancelled.command);
+    switch (cancelled.command){
+        case TaskCommandEnum::ADDFILTER:
+        {
+            Filter* f = database->GetFilterById(cancelled.subject);
+            if (f != NULL) database->RemoveFilter(f);
+        }
+        break;
+        case TaskCommandEnum::PLACECOMBINATION:
+            database->SetCombinationPlaced(cancelled.subject, false);
+            placedCombination = NULL;
+            break;
+        case TaskCommandEnum::REMOVECOMBINATION:
+            // Filters may still be stacked, the combination stays placed so it can be removed again
+            database->SetCombinationPlaced(cancelled.subject, true);
+            placedCombination = database->GetFilterCombination(cancelled.subject);
+            break;
+        default:
+            break;
+    }
+    for (Task& response : cancelled.responses) {
+        ResponseBuilder(response).Result(Resultcodes::ActionNotPerformedDueToState).Send(*queueHandler);
+    }
+}
 
-void Logic::taskToStep(Task task){
-    Logging::LogEnterFunction(__FUNCTION__, "");
-    Task* t = new Task(
-            task.GetMessageID(),
-            task.GetBlockID(),
-            task.GetPriority(),
-            task.GetCommand(),
-            TaskTypeEnum::RESPONSEMESSAGE
-    );
+void Logic::taskToStep(Task task, std::chrono::steady_clock::time_point received){
+    LOG_ENTER();
+    if (HasStepRoom(task.GetCommand())) {
+        // STOP has to halt the cabinet before any other task continues
+        int priority = task.GetCommand() == TaskCommandEnum::STOP ? std::numeric_limits<int>::max() : task.GetPriority();
+        queue.Begin(priority, task.GetCommand(), received);
+        // The state at the start of a group depends on the groups scheduled before it
+        optimizer.Reset();
+        buildSteps(task);
+        if (!queue.End()) {
+            // Answered without steps, the command is done
+            uint64_t elapsed = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - received).count();
+            metrics->CommandDone(task.GetCommand(), elapsed, elapsed);
+        }
+        return;
+    }
+    ResponseBuilder response(task);
+    LOG_WARNING("Logic > taskToStep > Step queue full");
+    response.Result(Resultcodes::ServerBusy);
+    response.Send(*queueHandler);
+}
 
+void Logic::buildSteps(Task& task){
+    ResponseBuilder response(task);
     switch (task.GetCommand()){
         case TaskCommandEnum::ADDFILTER:
 		{
-			Logging::LogEvent((int)LogLevels::LogDebug, "Logic > Received task > ADDFILTER");
-			Filter* f = new Filter;
-			f->index = database->GetFilterCount() + 1;
-			task.GetParameter(0)->AsString(&(f->id));
-			task.GetParameter(1)->AsString(&(f->material));
-			task.GetParameter(2)->AsString(&(f->thickness));
-			database->AddFilter(f);
-			queue.push(new Step(StepType::CRANE_MOVE, CRANE_HOME));
-			queue.push(new Step(StepType::ALL_DRAWERS_RETRACT));
-			queue.push(new Step(StepType::CRANE_MOVE, cranePositions[0]));
-			queue.push(new Step(StepType::MAGNET, magnetOn));
-			queue.push(new Step(StepType::CRANE_MOVE, CRANE_HOME));
-			//queue.push(new Step(StepType::CRANE_MOVE, (f->index < MAX_DRAWER-1) ? cranePositions[f->index+1] : MAX_DRAWER-1));
-			queue.push(new Step(StepType::DRAWER_EXTEND, f->index));
-			queue.push(new Step(StepType::CRANE_MOVE, cranePositions[f->index]));
-			queue.push(new Step(StepType::MAGNET, magnetOff));
-			queue.push(new Step(StepType::CRANE_MOVE, CRANE_HOME));
-			queue.push(new Step(StepType::ALL_DRAWERS_RETRACT));
-			t->AddParameter(std::to_string((int)Resultcodes::Success));
-			queue.push(new Step(StepType::SEND_RETURN_MESSAGE, t));
+			LOG_DEBUG("Logic > Received task > ADDFILTER");
+			Filter filter;
+			filter.index = database->GetFirstFreeDrawer();
+			task.GetParameter(0)->AsString(&(filter.id));
+			task.GetParameter(1)->AsString(&(filter.material));
+			task.GetParameter(2)->AsString(&(filter.thickness));
+			if (database->AddFilter(filter) < 0) {
+				response.Result(Resultcodes::DrawersFull);
+				response.Send(*queueHandler);
+				return;
+			}
+			filter.index = database->GetFilterById(filter.id)->index;
+			queue.SetSubject(filter.id);
+			QueueRecipe(Recipes::AddFilter, GetRecipeContext(filter.index, 0));
+			response.Result(Resultcodes::Success);
+			QueueResponse(response.Take());
 		}
 		break;
         case TaskCommandEnum::REQUESTADDFILTER:
 		{
-			Logging::LogEvent((int)LogLevels::LogDebug, "Logic > Received task > REQUESTADDFILTER");
+			LOG_DEBUG("Logic > Received task > REQUESTADDFILTER");
 			std::string id;
 			task.GetParameter(0)->AsString(&id);
 			int i = database->HasRoom(id);
 			if (i < 0) {
-				t->AddParameter(std::to_string((int)Resultcodes::DrawersFull));
-				queueHandler->AddTask(*t);
+				response.Result(Resultcodes::DrawersFull);
+				response.Send(*queueHandler);
 			}
 			else {
-				queue.push(new Step(StepType::CRANE_MOVE, CRANE_HOME));
-				queue.push(new Step(StepType::DRAWER_EXTEND, 0));
-				t->AddParameter(std::to_string((int)Resultcodes::Success));
-				queue.push(new Step(StepType::SEND_RETURN_MESSAGE, t));
+				QueueRecipe(Recipes::RequestAddFilter, GetRecipeContext(0, 0));
+				response.Result(Resultcodes::Success);
+				QueueResponse(response.Take());
 			}
 			
 		}
 		break;
         case TaskCommandEnum::CANCELADDFILTER:
 		{
-			Logging::LogEvent((int)LogLevels::LogDebug, "Logic > Received task > CANCELADDFILTER");
-			queue.push(new Step(StepType::ALL_DRAWERS_RETRACT));
-			t->AddParameter(std::to_string((int)Resultcodes::Success));
-			queueHandler->AddTask(*t);
+			LOG_DEBUG("Logic > Received task > CANCELADDFILTER");
+			QueueRecipe(Recipes::CancelAddFilter, GetRecipeContext(0, 0));
+			response.Result(Resultcodes::Success);
+			response.Send(*queueHandler);
 		}
         break;
         case TaskCommandEnum::REMOVEFILTER:
 		{
-			Logging::LogEvent((int)LogLevels::LogDebug, "Logic > Received task > REMOVEFILTER");
+			LOG_DEBUG("Logic > Received task > REMOVEFILTER");
 			std::string id;
 			task.GetParameter(0)->AsString(&id);
 			Filter* f = database->GetFilterById(id);
 			if (f == NULL) {
-				t->AddParameter(std::to_string((int)Resultcodes::InvalidParameter));
-				queueHandler->AddTask(*t);
+				response.Result(Resultcodes::InvalidParameter);
+				response.Send(*queueHandler);
 				return;
 			}
 			database->RemoveFilter(f);
-			queue.push(new Step(StepType::CRANE_MOVE, CRANE_HOME));
-			queue.push(new Step(StepType::ALL_DRAWERS_RETRACT));
-			t->AddParameter(std::to_string((int)Resultcodes::Success));
-			queue.push(new Step(StepType::SEND_RETURN_MESSAGE, t));
+			QueueRecipe(Recipes::Park, GetRecipeContext(0, 0));
+			response.Result(Resultcodes::Success);
+			QueueResponse(response.Take());
 		}
         break;
 		case TaskCommandEnum::REQUESTREMOVEFILTER: 
 		{
-			Logging::LogEvent((int)LogLevels::LogDebug, "Logic > Received task > REQUESTREMOVEFILTER");
+			LOG_DEBUG("Logic > Received task > REQUESTREMOVEFILTER");
 			std::string id;
 			task.GetParameter(0)->AsString(&id);
 			Filter* f = database->GetFilterById(id);
 			if (f == NULL) {
-				t->AddParameter(std::to_string((int)Resultcodes::InvalidParameter));
-				queueHandler->AddTask(*t);
+				response.Result(Resultcodes::InvalidParameter);
+				response.Send(*queueHandler);
 				return;
 			}
-			queue.push(new Step(StepType::CRANE_MOVE, CRANE_HOME));
-			queue.push(new Step(StepType::ALL_DRAWERS_RETRACT));
-			queue.push(new Step(StepType::DRAWER_EXTEND, f->index));
-			queue.push(new Step(StepType::CRANE_MOVE, cranePositions[(f->index)]));
-			queue.push(new Step(StepType::MAGNET, magnetOn));
-			//queue.push(new Step(StepType::CRANE_MOVE, CRANE_HOME));
-			
-			queue.push(new Step(StepType::ALL_DRAWERS_RETRACT));
-			queue.push(new Step(StepType::CRANE_MOVE, cranePositions[(0)]));
-			queue.push(new Step(StepType::MAGNET, magnetOff));
-			queue.push(new Step(StepType::CRANE_MOVE, CRANE_HOME));
-			queue.push(new Step(StepType::DRAWER_EXTEND, 0));
-			t->AddParameter(std::to_string((int)Resultcodes::Success));
-			queue.push(new Step(StepType::SEND_RETURN_MESSAGE, t));
+			QueueRecipe(Recipes::RequestRemoveFilter, GetRecipeContext(f->index, 0));
+			response.Result(Resultcodes::Success);
+			QueueResponse(response.Take());
 		}
         break;
         case TaskCommandEnum::CANCELREMOVEFILTER:
 		{
-			Logging::LogEvent((int)LogLevels::LogDebug, "Logic > Received task > CANCELREMOVEFILTER");
+			LOG_DEBUG("Logic > Received task > CANCELREMOVEFILTER");
 			//Currently doesnt place filter back in drawer, needs knowledge of filter
-			queue.push(new Step(StepType::CRANE_MOVE, CRANE_HOME));
-			queue.push(new Step(StepType::ALL_DRAWERS_RETRACT));
-			t->AddParameter(std::to_string((int)Resultcodes::Success));
-			queueHandler->AddTask(*t);
+			QueueRecipe(Recipes::Park, GetRecipeContext(0, 0));
+			response.Result(Resultcodes::Success);
+			response.Send(*queueHandler);
 		}
         break;
         case TaskCommandEnum::GETFILTERS:
-        {
-			Logging::LogEvent((int)LogLevels::LogDebug, "Logic > Received task > GETFILTERS");
-			std::vector<Filter*> filters = database->GetFilters();
-			t->AddParameter(std::to_string((int)Resultcodes::Success));
-			for (int i = 0; i < (int)filters.size(); i++) {
-				t->AddParameter(filters.at(i)->id);
-				t->AddParameter(filters.at(i)->material);
-				t->AddParameter(filters.at(i)->thickness);
+        case TaskCommandEnum::GETFILTERCOMBINATIONS:
+        case TaskCommandEnum::GETSYSTEMSTATUS:
+		{
+			// Read-only, answered from a database snapshot
+			AnswerQuery(task);
+		}
+        break;
+        case TaskCommandEnum::GETFILTERSBYMATERIAL:
+		{
+			LOG_DEBUG("Logic > Received task > GETFILTERSBYMATERIAL");
+			if (task.GetParameter(0) == NULL) {
+				response.Result(Resultcodes::ParameterCountError);
+				response.Send(*queueHandler);
+				return;
 			}
-			queueHandler->AddTask(*t);
-        }
+			std::string material;
+			task.GetParameter(0)->AsString(&material);
+			response.Result(Resultcodes::Success);
+			for (const Filter* f : database->GetFiltersByMaterial(material)) {
+				response.Add(f->id);
+				response.Add(f->material);
+				response.Add(f->thickness);
+			}
+			response.Send(*queueHandler);
+		}
+        break;
+        case TaskCommandEnum::GETFILTERSBYTHICKNESS:
+		{
+			LOG_DEBUG("Logic > Received task > GETFILTERSBYTHICKNESS");
+			if (task.GetParameter(0) == NULL || task.GetParameter(1) == NULL) {
+				response.Result(Resultcodes::ParameterCountError);
+				response.Send(*queueHandler);
+				return;
+			}
+			std::string minimum, maximum;
+			task.GetParameter(0)->AsString(&minimum);
+			task.GetParameter(1)->AsString(&maximum);
+			double low, high;
+			if (!Database::ParseThickness(minimum, &low) || !Database::ParseThickness(maximum, &high)) {
+				LOG_DEBUG("Logic > GETFILTERSBYTHICKNESS > Thickness is not a number");
+				response.Result(Resultcodes::InvalidParameter);
+				response.Send(*queueHandler);
+				return;
+			}
+			response.Result(Resultcodes::Success);
+			for (const Filter* f : database->GetFiltersByThickness(low, high)) {
+				response.Add(f->id);
+				response.Add(f->material);
+				response.Add(f->thickness);
+			}
+			response.Send(*queueHandler);
+		}
+        break;
+        case TaskCommandEnum::GETFREEDRAWER:
+		{
+			LOG_DEBUG("Logic > Received task > GETFREEDRAWER");
+			int drawer = database->GetFirstFreeDrawer();
+			if (drawer < 0) {
+				response.Result(Resultcodes::DrawersFull);
+			}
+			else {
+				response.Result(Resultcodes::Success);
+				response.Add(std::to_string(drawer));
+			}
+			response.Send(*queueHandler);
+		}
         break;
         case TaskCommandEnum::ADDFILTERCOMBINATION:
 		{
-			Logging::LogEvent((int)LogLevels::LogDebug, "Logic > Received task > ADDFILTERCOMBINATION");
-			Combination* c = new Combination;
-			task.GetParameter(0)->AsString(&(c->id));
-			task.GetParameter(1)->AsString(&(c->name));
+			LOG_DEBUG("Logic > Received task > ADDFILTERCOMBINATION");
+			Combination c;
+			task.GetParameter(0)->AsString(&(c.id));
+			task.GetParameter(1)->AsString(&(c.name));
 			int nr = 0;
 			task.GetParameter(2)->AsInt(&nr);
 			for (int i = 0; i < nr; i++) {
 				std::string id = "";
 				task.GetParameter(i + 3)->AsString(&id);
-				Filter* f = database->GetFilterById(id);
-				if (f == NULL) {
-					t->AddParameter(std::to_string((int)Resultcodes::FilterCombinationError));
-					queueHandler->AddTask(*t);
+				FilterHandle f = database->GetFilterHandle(id);
+				if (f == InvalidHandle) {
+					response.Result(Resultcodes::FilterCombinationError);
+					response.Send(*queueHandler);
 					return;
 				}
-				c->filters.push_back(f);
+				c.filters.push_back(f);
 			}
 			int ret = database->AddFilterCombination(c);
-			if (ret < 0) t->AddParameter(std::to_string((int)Resultcodes::InvalidParameter));
-			else t->AddParameter(std::to_string((int)Resultcodes::Success));
-			queueHandler->AddTask(*t);
+			if (ret < 0) response.Result(Resultcodes::InvalidParameter);
+			else response.Result(Resultcodes::Success);
+			response.Send(*queueHandler);
 
 		}
         break;
         case TaskCommandEnum::REMOVEFILTERCOMBINATION:
 		{
-			Logging::LogEvent((int)LogLevels::LogDebug, "Logic > Received task > REMOVEFILTERCOMBINATION");
+			LOG_DEBUG("Logic > Received task > REMOVEFILTERCOMBINATION");
 			std::string id = "";
 			task.GetParameter(0)->AsString(&id);
 			int ret = database->RemoveFilterCombination(id);
-			if (ret < 0) t->AddParameter(std::to_string((int)Resultcodes::InvalidParameter));
-			else t->AddParameter(std::to_string((int)Resultcodes::Success));
-			queueHandler->AddTask(*t);
-		}
-        break;
-        case TaskCommandEnum::GETFILTERCOMBINATIONS:
-		{
-			Logging::LogEvent((int)LogLevels::LogDebug, "Logic > Received task > GETFILTERCOMBINATIONS");
-			t->AddParameter(std::to_string((int)Resultcodes::Success));
-			std::vector<Combination*> combinations = database->GetFilterCombinations();
-			for (int i = 0; i < (int)combinations.size(); i++) {
-				Combination* c = combinations.at(i);
-				t->AddParameter(c->id);
-				t->AddParameter(c->name);
-				t->AddParameter(c->placed ? "true" : "false");
-				t->AddParameter(std::to_string(c->filters.size()));
-				for (int j = 0; j < (int)c->filters.size(); j++) {
-					t->AddParameter(c->filters.at(j)->id);
-				}
-			}
-			queueHandler->AddTask(*t);
+			if (ret < 0) response.Result(Resultcodes::InvalidParameter);
+			else response.Result(Resultcodes::Success);
+			response.Send(*queueHandler);
 		}
         break;
         case TaskCommandEnum::PLACECOMBINATION:
 		{
-			Logging::LogEvent((int)LogLevels::LogDebug, "Logic > Received task > PLACECOMBINATION");
+			LOG_DEBUG("Logic > Received task > PLACECOMBINATION");
 			std::string id = "";
 			task.GetParameter(0)->AsString(&id);
 			placedCombination = database->GetPlacedCombination();
 			if(placedCombination != NULL){
-				t->AddParameter(std::to_string((int)Resultcodes::FilterCombinationError));
-				queueHandler->AddTask(*t);
-				Logging::LogEvent((int)LogLevels::LogDebug, "Logic > PLACECOMBINATION > Combination already placed");
+				response.Result(Resultcodes::FilterCombinationError);
+				response.Send(*queueHandler);
+				LOG_DEBUG("Logic > PLACECOMBINATION > Combination already placed");
 				return;
 			}
 			placedCombination = database->GetFilterCombination(id);
 			if (placedCombination == NULL) {
-				t->AddParameter(std::to_string((int)Resultcodes::FilterCombinationError));
-				queueHandler->AddTask(*t);
-				Logging::LogEvent((int)LogLevels::LogDebug, "Logic > PLACECOMBINATION > Combination not found");
+				response.Result(Resultcodes::FilterCombinationError);
+				response.Send(*queueHandler);
+				LOG_DEBUG("Logic > PLACECOMBINATION > Combination not found");
 				return;
 			}
-			queue.push(new Step(StepType::ALL_DRAWERS_RETRACT));
-			queue.push(new Step(StepType::CRANE_MOVE, CRANE_HOME));
+			queue.SetSubject(placedCombination->id);
+			QueueRecipe(Recipes::CombinationPrologue, GetRecipeContext(0, 0));
 			for (int i = 0; i < (int)placedCombination->filters.size(); i++) {
-				Filter* f = placedCombination->filters.at(i);
-				queue.push(new Step(StepType::DRAWER_EXTEND, f->index));
-				queue.push(new Step(StepType::CRANE_MOVE, cranePositions[(f->index)]));
-				queue.push(new Step(StepType::MAGNET, magnetOn));
-				queue.push(new Step(StepType::CRANE_MOVE, CRANE_HOME));
-				queue.push(new Step(StepType::ALL_DRAWERS_RETRACT));
-				queue.push(new Step(StepType::CRANE_MOVE, cranePositions[(0)] - (i * 10)));
-				queue.push(new Step(StepType::MAGNET, magnetOff));
-				queue.push(new Step(StepType::CRANE_MOVE, CRANE_HOME));
+				Filter* f = database->GetFilter(placedCombination->filters.at(i));
+				QueueRecipe(Recipes::PlaceFilter, GetRecipeContext(f->index, i));
 			}
-			placedCombination->placed = true;
-			queue.push(new Step(StepType::DRAWER_EXTEND, 0));
-			Task* cb = new Task(
-				task.GetMessageID(),
-				task.GetBlockID(),
-				task.GetPriority(),
-				TaskCommandEnum::PLACEFILTERCOMBINATIONCALLBACK,
-				TaskTypeEnum::RESPONSEMESSAGE
-			);
-			cb->AddParameter(std::to_string((int)Resultcodes::Success));
-			queue.push(new Step(StepType::SEND_RETURN_MESSAGE, cb));
-			t->AddParameter(std::to_string((int)Resultcodes::Success));
-			queueHandler->AddTask(*t);
+			database->SetCombinationPlaced(placedCombination->id, true);
+			QueueRecipe(Recipes::PlaceEpilogue, GetRecipeContext(0, 0));
+			ResponseBuilder callback(task, TaskCommandEnum::PLACEFILTERCOMBINATIONCALLBACK);
+			callback.Result(Resultcodes::Success);
+			QueueResponse(callback.Take());
+			response.Result(Resultcodes::Success);
+			response.Send(*queueHandler);
 		}
 		break;
         case TaskCommandEnum::REMOVECOMBINATION:
 		{
-			Logging::LogEvent((int)LogLevels::LogDebug, "Logic > Received task > REMOVECOMBINATION");
+			LOG_DEBUG("Logic > Received task > REMOVECOMBINATION");
 			placedCombination = database->GetPlacedCombination();
 			if (placedCombination == NULL) {
-				t->AddParameter(std::to_string((int)Resultcodes::FilterCombinationError));
-				queueHandler->AddTask(*t);
-				Logging::LogEvent((int)LogLevels::LogDebug, "Logic > REMOVECOMBINATION > No combination placed");
+				response.Result(Resultcodes::FilterCombinationError);
+				response.Send(*queueHandler);
+				LOG_DEBUG("Logic > REMOVECOMBINATION > No combination placed");
 				return;
 			}
-			queue.push(new Step(StepType::ALL_DRAWERS_RETRACT));
-			queue.push(new Step(StepType::CRANE_MOVE, CRANE_HOME));
+			queue.SetSubject(placedCombination->id);
+			QueueRecipe(Recipes::CombinationPrologue, GetRecipeContext(0, 0));
 			for (int i = placedCombination->filters.size() - 1; i >= 0; i--) {
-				Filter* f = placedCombination->filters.at(i);
-				queue.push(new Step(StepType::CRANE_MOVE, cranePositions[(0)] - (i * 10)));
-				queue.push(new Step(StepType::MAGNET, magnetOn));
-				queue.push(new Step(StepType::CRANE_MOVE, CRANE_HOME));
-				queue.push(new Step(StepType::DRAWER_EXTEND, f->index));
-				queue.push(new Step(StepType::CRANE_MOVE, cranePositions[(f->index)]));
-				queue.push(new Step(StepType::MAGNET, magnetOff));
-				queue.push(new Step(StepType::CRANE_MOVE, CRANE_HOME));
-				queue.push(new Step(StepType::ALL_DRAWERS_RETRACT));
+				Filter* f = database->GetFilter(placedCombination->filters.at(i));
+				// Filters are stacked in combination order, unstack from the top
+				QueueRecipe(Recipes::RemoveFilter, GetRecipeContext(f->index, i));
 			}
-			placedCombination->placed = false;
-			Task* cb = new Task(
-				task.GetMessageID(),
-				task.GetBlockID(),
-				task.GetPriority(),
-				TaskCommandEnum::REMOVEFILTERCOMBINATIONCALLBACK,
-				TaskTypeEnum::RESPONSEMESSAGE
-				);
-			cb->AddParameter(std::to_string((int)Resultcodes::Success));
-			queue.push(new Step(StepType::SEND_RETURN_MESSAGE, cb));
+			database->SetCombinationPlaced(placedCombination->id, false);
+			ResponseBuilder callback(task, TaskCommandEnum::REMOVEFILTERCOMBINATIONCALLBACK);
+			callback.Result(Resultcodes::Success);
+			QueueResponse(callback.Take());
 			placedCombination = NULL;
-			t->AddParameter(std::to_string((int)Resultcodes::Success));
-			queueHandler->AddTask(*t);
+			response.Result(Resultcodes::Success);
+			response.Send(*queueHandler);
 		}
         break;
-        case TaskCommandEnum::GETSYSTEMSTATUS:
+        case TaskCommandEnum::GETSYSTEMLOG:
 		{
-			Logging::LogEvent((int)LogLevels::LogDebug, "Logic > Received task > GETSYSTEMSTATUS");
-            t->AddParameter(std::to_string((int)Resultcodes::Success));
-            t->AddParameter("Nominal");
-            t->AddParameter("1.0");
-            int emptyDrawerCount = this->database->GetMaxFilterCount() - this->database->GetFilterCount();
-            t->AddParameter(std::to_string(emptyDrawerCount));
-            queueHandler->AddTask(*t);
+			LOG_DEBUG("Logic > Received task > GETSYSTEMLOG");
+			// Optional parameters: sequence number of the last event the client has, page size
+			uint64_t since = 0;
+			int pageSize = SYSTEMLOG_PAGE_SIZE;
+			std::string value;
+			if (task.GetParameter(0) != NULL) {
+				task.GetParameter(0)->AsString(&value);
+				since = std::strtoull(value.c_str(), NULL, 10);
+			}
+			if (task.GetParameter(1) != NULL) {
+				task.GetParameter(1)->AsString(&value);
+				pageSize = std::atoi(value.c_str());
+			}
+			if (pageSize <= 0) pageSize = SYSTEMLOG_PAGE_SIZE;
+			if (pageSize > SYSTEMLOG_MAX_PAGE_SIZE) pageSize = SYSTEMLOG_MAX_PAGE_SIZE;
+			// Store records still waiting in the log ring buffer first, events other components logged
+			// through Logging are imported by the flusher thread
+			FastLog::Flush();
+			std::vector<EventRecord> events;
+			events.reserve(pageSize);
+			uint64_t next = EventLog::Read(since, pageSize, events);
+			response.Result(Resultcodes::Success);
+			response.Add(std::to_string(next));
+			response.Add(std::to_string(events.size()));
+			for (const EventRecord& event : events) {
+				response.Add(std::to_string(event.sequence));
+				response.Add(std::to_string(event.timeUs));
+				response.Add(std::to_string((int)event.level));
+				response.Add(std::to_string(event.code));
+				response.Add(EventLog::Format(event));
+			}
+			response.Send(*queueHandler);
 		}
         break;
-        case TaskCommandEnum::GETSYSTEMLOG:
+        case TaskCommandEnum::GETMETRICS:
 		{
-			Logging::LogEvent((int)LogLevels::LogDebug, "Logic > Received task > GETSYSTEMLOG");
-			std::stringstream ss;
-			std::vector<std::string> events =  Logging::GetEvents();
-			for(unsigned int i = 0; i < events.size(); i++){
-				ss << events[i] << std::endl;
-			}	
-			t->AddParameter(std::to_string((int)Resultcodes::Success));
-            if (ss.str() == "") 
-            {
-                ss << "Empty" << std::endl;
-            }
-            t->AddParameter(ss.str());
-			queueHandler->AddTask(*t);
+			LOG_DEBUG("Logic > Received task > GETMETRICS");
+			response.Result(Resultcodes::Success);
+			response.Add(metrics->Dump());
+			response.Send(*queueHandler);
 		}
         break;
         case TaskCommandEnum::STOP:
 		{
-			Logging::LogEvent((int)LogLevels::LogDebug, "Logic > Received task > STOP");
-			t->AddParameter(std::to_string((int)Resultcodes::Success));
-			queueHandler->AddTask(*t);
-			queue.push(new Step(StepType::STOP_HAL));
+			LOG_DEBUG("Logic > Received task > STOP");
+			response.Result(Resultcodes::Success);
+			response.Send(*queueHandler);
+			QueueStep(Step(StepType::STOP_HAL));
 		}
         break;
         case TaskCommandEnum::RESET:
 		{
-			Logging::LogEvent((int)LogLevels::LogDebug, "Logic > Received task > RESET");
-			t->AddParameter(std::to_string((int)Resultcodes::Success));
-			queueHandler->AddTask(*t);
-			queue.push(new Step(StepType::START_HAL));
+			LOG_DEBUG("Logic > Received task > RESET");
+			response.Result(Resultcodes::Success);
+			response.Send(*queueHandler);
+			QueueStep(Step(StepType::START_HAL));
 		}
         break;
         case TaskCommandEnum::PLACEFILTERCOMBINATIONCALLBACK:
 		{
-			Logging::LogEvent((int)LogLevels::LogWarning, "Logic > Received task > PLACEFILTERCALLBACK");
-			t->AddParameter(std::to_string((int)Resultcodes::UnknownMessage));
-			queueHandler->AddTask(*t);
+			LOG_WARNING("Logic > Received task > PLACEFILTERCALLBACK");
+			response.Result(Resultcodes::UnknownMessage);
+			response.Send(*queueHandler);
 			//Shouldn't get this command
 		}
         break;
         case TaskCommandEnum::REMOVEFILTERCOMBINATIONCALLBACK:
 		{
-			Logging::LogEvent((int)LogLevels::LogWarning, "Logic > Received task > REMOVEFILTERCALLBACK");
-			t->AddParameter(std::to_string((int)Resultcodes::UnknownMessage));
-			queueHandler->AddTask(*t);
+			LOG_WARNING("Logic > Received task > REMOVEFILTERCALLBACK");
+			response.Result(Resultcodes::UnknownMessage);
+			response.Send(*queueHandler);
 			//Shouldn't get this command
 		}
 		break;
@@ -4,30 +4,72 @@
 
 #pragma once
 
-#include <queue>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
 
 #include "IHandlerCB.h"
 #include "Error.h"
 
 #include "Step.hpp"
 #include "Task.h"
-#include "hal.hpp"
+#include "TaskCommands.hpp"
+#include "IHal.hpp"
+#include "HalAdapter.hpp"
 #include "IQueueHandler.h"
 #include "Database.hpp"
+#include "DatabaseSaver.hpp"
 #include "Logging.hpp"
+#include "FastLog.hpp"
+#include "EventLog.hpp"
+#include "RingBuffer.hpp"
+#include "StepOptimizer.hpp"
+#include "StepScheduler.hpp"
+#include "StepRecipe.hpp"
+#include "Metrics.hpp"
+#include "ResponseBuilder.hpp"
 
     #define CRANE_HOME 0
-enum class Resultcodes {
-	Success = 0,
-	CommunicationError = -1,
-	UnknownMessage = -2,
-	ParameterCountError = -3,
-	InvalidParameter = -4,
-	ServerBusy = -5,
-	ActionNotPerformedDueToState = -6,
-	DrawersFull = -7,
-	FilterCombinationError = -8
-};
+
+/// \brief      Counters of the step runner
+typedef struct {
+    uint64_t tickCount = 0;                 ///< Number of ticks that found the HAL ready with steps queued
+    uint64_t stepCount = 0;                 ///< Number of steps executed
+    uint64_t maxStepsPerTick = 0;           ///< Most steps executed in one tick
+    uint64_t responseCount = 0;             ///< Number of queued return messages sent
+    uint64_t totalResponseLatencyUs = 0;    ///< Sum of time between queueing and sending return messages
+    uint64_t maxResponseLatencyUs = 0;      ///< Longest time between queueing and sending a return message
+}RunStatistics;
+
+/// \brief      Task waiting in the event loop inbox
+typedef struct {
+    Task task;                                          ///< Received task
+    std::chrono::steady_clock::time_point received;     ///< Time of the callback
+}ReceivedTask;
+
+/// \brief      Parameters of a query response, valid while the database generation is unchanged
+typedef struct {
+    uint64_t generation = 0;                            ///< Database generation the parameters were built from
+    std::vector<std::string> parameters;                ///< Result code and data of the response
+}CachedResponse;
+
+/// \brief      Number of cached query responses, one per read-only command
+#define QUERY_CACHE_SIZE 3
+
+/// \brief      Started step the HAL is busy with, timed for the metrics
+typedef struct {
+    bool used = false;                                  ///< False if the slot is free
+    StepType type = StepType::NONE;                     ///< Type of the step
+    uint64_t resources = 0;                             ///< HAL resources the step waits for
+    std::chrono::steady_clock::time_point started;      ///< Time the step was started
+}TimedStep;
 
 /// \brief      Main logic functionality
 class Logic : public IHandlerCB
@@ -40,24 +82,80 @@ public:
     /// \returns    Nothing
     Logic(IQueueHandler* queueHandler);
 
+    /// \brief      Constructor with a HAL implementation
+    /// \pre        None.
+    /// \post       Initialized logic and HAL.
+    /// \param[in]  queueHandler Link to queue object of API layer for return messages
+    /// \param[in]  hal HAL to control, not owned by logic, for example a SimHal
+    /// \returns    Nothing
+    Logic(IQueueHandler* queueHandler, IHal* hal);
+
     /// \brief      Destructor
     /// \pre        Initialized logic.
     /// \post       Cleaned HAL and logic.
     /// \returns    Nothing
     ~Logic(void);
 
-    /// \brief      Main run function of logic, runs the first step in its queue.
+    /// \brief      Main run function of logic, runs the first steps in its queue.
     /// \pre        None. (Preferably added tasks using queue callback)
-    /// \post       A step has been executed, next step will be run next call to prevent blocking.
+    /// \post       Steps have been executed up to and including the first step that waits for the HAL,
+    ///             at most the step budget. Remaining steps will be run next call to prevent blocking.
     /// \returns    Void
     void Run(void);
 
+    /// \brief      Sets the maximum number of steps executed in one Run() call.
+    /// \pre        None.
+    /// \post       Budget set, at least 1.
+    /// \param[in]  budget Maximum number of steps per call
+    /// \returns    Void
+    void SetStepBudget(int budget);
+
+    /// \brief      Get counters of the step runner
+    /// \pre        None.
+    /// \post       None.
+    /// \returns    Steps per tick and return message latency
+    RunStatistics GetRunStatistics(void);
+
+    /// \brief      Event driven run loop, runs steps until StopEventLoop() is called.
+    /// \pre        No other thread calls Run().
+    /// \post       Tasks received through callback during the loop are converted to steps on the
+    ///             calling thread. The loop sleeps while there is no step to run and wakes on a new
+    ///             task or a HAL state change. HALs that can not report state changes are polled
+    ///             while busy. The database is saved each time the step queue runs empty.
+    /// \returns    Void
+    void RunEventLoop(void);
+
+    /// \brief      Makes RunEventLoop() return, may be called from any thread.
+    /// \pre        None.
+    /// \post       Event loop woken up and stopping.
+    /// \returns    Void
+    void StopEventLoop(void);
+
     /// \brief      Saves database to disk
     /// \pre        None.
-    /// \post       Database.txt file has been created
+    /// \post       Journal synced. Changed database handed to the background saver if there is no journal or
+    ///             it reached JOURNAL_COMPACT_THRESHOLD records. Does not wait for disk writes.
     /// \returns    Void
     void Save(void);
 
+    /// \brief      Get counters of the background database saver
+    /// \pre        None.
+    /// \post       None.
+    /// \returns    Snapshot count, durations and bytes written
+    SaverStatistics GetSaverStatistics(void);
+
+    /// \brief      Get counters of the step optimizer
+    /// \pre        None.
+    /// \post       None.
+    /// \returns    Steps removed and estimated seconds saved
+    OptimizerStatistics GetOptimizerStatistics(void);
+
+    /// \brief      Get latency, throughput, queue depth and HAL busy metrics
+    /// \pre        None.
+    /// \post       None.
+    /// \returns    Metrics as a JSON object
+    std::string DumpMetrics(void);
+
     /// \brief      Callback inherited from IHandlerCB, adds task to queue for processing when calling Run().
     /// \pre        None.
     /// \post       The task had been converted to steps and added to the stepQueue
@@ -68,19 +166,59 @@ public:
 
 private:
     /// \brief      Reference to cabinet hardware for storing filters
-    Hal* hal;
+    IHal* hal;
+    /// \brief      True if hal was created by logic and has to be deleted
+    bool ownsHal;
     /// \brief      Pointer to database for storing information
     Database* database;
+    /// \brief      Writes database snapshots off the control loop
+    DatabaseSaver* saver;
     /// \brief      Reference to queue handler for return messages
     IQueueHandler* queueHandler;
-    /// \brief      Queue of steps that need to be executed and do not need to wait for hal
-    std::queue<Step*> queue;
+    /// \brief      Steps that need to be executed, grouped per task and ordered by task priority
+    StepScheduler queue{CRANE_HOME};
+    /// \brief      Crane position after the executed steps, -1 if unknown
+    int craneState = -1;
+    /// \brief      Magnet state after the executed steps, -1 if unknown
+    int magnetState = -1;
+    /// \brief      False if a drawer may be extended after the executed steps
+    bool drawersClosed = false;
+    /// \brief      True after a STOP_HAL step until the next START_HAL step
+    bool halStopped = false;
+    /// \brief      True once a HAL error has been handled, until the next START_HAL step
+    bool halFailed = false;
+    /// \brief      Maximum number of steps executed in one tick
+    int stepBudget;
+    /// \brief      Counters of the step runner
+    RunStatistics runStatistics;
+    /// \brief      True while RunEventLoop() is running
+    std::atomic<bool> eventMode{false};
+    /// \brief      Protects inbox, stopRequested and halChanged, held while the inbox is emptied at stop
+    std::mutex eventMutex;
+    /// \brief      Wakes the event loop
+    std::condition_variable wakeup;
+    /// \brief      Tasks received while the event loop runs
+    std::deque<ReceivedTask> inbox;
+    /// \brief      Set by StopEventLoop()
+    bool stopRequested = false;
+    /// \brief      Set by the HAL status callback
+    bool halChanged = false;
+    /// \brief      Last response per read-only command. Accessed with atomic_load and atomic_store.
+    std::shared_ptr<const CachedResponse> queryCache[QUERY_CACHE_SIZE];
+    /// \brief      Latency and throughput metrics
+    Metrics* metrics;
+    /// \brief      Started steps waiting for the HAL, timed for the metrics
+    TimedStep timedSteps[METRICS_TIMED_STEPS];
+    /// \brief      Removes queued steps that do not change the cabinet state
+    StepOptimizer optimizer;
 	/// \brief      Filter combination currently placed
 	Combination* placedCombination;
 
     /// \brief      Constants for crane position
     
     const int cranePositions[5] = {140,105,75,35,CRANE_HOME};
+    /// \brief      Distance between stack slots, slot i is at cranePositions[0] - i * stackPitch
+    static const int stackPitch = 10;
     // static const int craneDrawer3 = 35;
     // static const int craneDrawer2 = 70;
     // static const int craneDrawer1 = 105;
@@ -89,12 +227,123 @@ private:
     static const int magnetOn = 1;
     static const int magnetOff = 0;
 
+    /// \brief      Answers read-only commands from a database snapshot, safe to call from any thread.
+    /// \pre        None.
+    /// \post       Response added to the queue handler if the task is a query.
+    /// \param[in]  task Task to answer
+    /// \returns    True if the task was a query and has been answered, false otherwise
+    bool AnswerQuery(Task& task);
+
+    /// \brief      Builds the response parameters of a read-only command from a database snapshot.
+    /// \pre        command is GETFILTERS, GETFILTERCOMBINATIONS or GETSYSTEMSTATUS.
+    /// \post       None.
+    /// \param[in]  command Command to answer
+    /// \returns    Parameters with the generation of the snapshot they were built from
+    std::shared_ptr<const CachedResponse> BuildQueryResponse(TaskCommandEnum command);
+
+    /// \brief      Initializes HAL and loads the database, shared by the constructors.
+    /// \pre        hal and queueHandler set.
+    /// \post       HAL initialized, database loaded and saver started.
+    /// \returns    Void
+    void Init(void);
+
+    /// \brief      Runs steps from the queue if the HAL is ready.
+    /// \pre        None.
+    /// \post       Steps executed until one waits for the HAL, the queue is empty or the budget is used.
+    /// \returns    Number of steps executed
+    int RunSteps(void);
+
+    /// \brief      Checks if the steps of a command fit in the step queue.
+    /// \pre        None.
+    /// \post       None.
+    /// \param[in]  command Command to check
+    /// \returns    True if the command queues no steps or there is room for its steps, false otherwise
+    bool HasStepRoom(TaskCommandEnum command);
+
+    /// \brief      Updates the cabinet state with an executed step.
+    /// \pre        Step executed.
+    /// \post       craneState, magnetState and drawersClosed updated.
+    /// \param[in]  step Executed step
+    /// \returns    Void
+    void TrackState(const Step& step);
+
+    /// \brief      Checks if the running task may be interrupted by a task with a higher priority.
+    /// \pre        None.
+    /// \post       None.
+    /// \returns    True if the crane is home, the magnet is off and all drawers are retracted
+    bool IsSafePoint(void);
+
+    /// \brief      Adds a step to the step queue through the optimizer.
+    /// \pre        HasStepRoom returned true for the current task.
+    /// \post       Step queued, merged with the last queued step or dropped.
+    /// \param[in]  step Step to queue
+    /// \returns    Void
+    void QueueStep(Step step);
+
+    /// \brief      Adds the steps of a recipe to the step queue through the optimizer.
+    /// \pre        HasStepRoom returned true for the current task.
+    /// \post       Recipe steps queued with their parameters resolved from the context.
+    /// \param[in]  recipe Steps to queue
+    /// \param[in]  context Drawer and stack slot of the command
+    /// \returns    Void
+    template <std::size_t Size>
+    void QueueRecipe(const StepRecipe<Size>& recipe, const RecipeContext& context);
+
+    /// \brief      Gets the recipe context of a drawer and stack slot.
+    /// \pre        drawer is a valid drawer index.
+    /// \post       None.
+    /// \param[in]  drawer Drawer of the command
+    /// \param[in]  slot Stack slot of the command
+    /// \returns    Context with the crane positions of drawer and slot
+    RecipeContext GetRecipeContext(int drawer, int slot);
+
+    /// \brief      Stores a return message and queues the step sending it.
+    /// \pre        HasStepRoom returned true for the current task.
+    /// \post       Response moved into the response queue, SEND_RETURN_MESSAGE step queued.
+    /// \param[in]  response Return message to send
+    /// \returns    Void
+    void QueueResponse(Task&& response);
+
+    /// \brief      Cancels the running task because the HAL stopped or failed.
+    /// \pre        None.
+    /// \post       Running step group removed and failed with FailTask, nothing done if none runs.
+    /// \returns    Void
+    void FailRunning(void);
+
+    /// \brief      Undoes the database change of a cancelled task and answers its pending messages.
+    /// \pre        Task removed from the step queue.
+    /// \post       Database change reverted, return messages sent with ActionNotPerformedDueToState.
+    /// \param[in]  cancelled Cancelled task
+    /// \returns    Void
+    void FailTask(CancelledTask& cancelled);
+
     /// \brief      Converts a task into smaller steps and adds these to the stepQueue.
     /// \pre        None.
-    /// \post       A number of steps have been added to the stepQueue.
+    /// \post       A number of steps have been added to the stepQueue as one group with the task priority.
     /// \param[in]  task Task to be converted and added to stepQueue
+    /// \param[in]  received Time the task was received by callback
+    /// \returns    Void
+    void taskToStep(Task task, std::chrono::steady_clock::time_point received);
+
+    /// \brief      Starts timing a step that keeps the HAL busy.
+    /// \pre        Step executed and waiting for the HAL.
+    /// \post       Step timed until its resources are no longer busy, ignored if all slots are used.
+    /// \param[in]  step Executed step
+    /// \returns    Void
+    void TimeStep(const Step& step);
+
+    /// \brief      Records the metrics of timed steps the HAL has finished.
+    /// \pre        hal->run() called.
+    /// \post       Finished steps counted and their slots freed.
+    /// \returns    Void
+    void FinishTimedSteps(void);
+
+    /// \brief      Converts a task into steps in the open step group.
+    /// \pre        Step group opened.
+    /// \post       Steps added, response sent or queued.
+    /// \param[in]  task Task to be converted
     /// \returns    Void
-    void taskToStep(Task task);
+    void buildSteps(Task& task);
 
 
 };
\ No newline at end of file
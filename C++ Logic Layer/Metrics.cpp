@@ -0,0 +1,184 @@
+/// \file       Metrics.cpp
+
+#include "Metrics.hpp"
+
+#include <cmath>
+#include <cstdio>
+
+/// \brief      Names of the step types in the dump, in StepType order
+static const char* stepNames[METRICS_STEP_TYPE_COUNT] = {
+    "DRAWER_EXTEND", "ALL_DRAWERS_RETRACT", "CRANE_MOVE", "MAGNET",
+    "SEND_RETURN_MESSAGE", "STOP_HAL", "START_HAL", "NONE"
+};
+
+/// \brief      Microseconds between two time points
+static uint64_t ElapsedUs(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to){
+    if (to <= from) return 0;
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(to - from).count();
+}
+
+LatencyHistogram::LatencyHistogram(void){
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) buckets[i] = 0;
+    count = 0;
+    sum = 0;
+    max = 0;
+}
+
+void LatencyHistogram::Record(uint64_t value){
+    buckets[BucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+    uint64_t largest = max.load(std::memory_order_relaxed);
+    while (value > largest && !max.compare_exchange_weak(largest, value, std::memory_order_relaxed));
+}
+
+uint64_t LatencyHistogram::GetCount(void) const{
+    return count.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::GetMax(void) const{
+    return max.load(std::memory_order_relaxed);
+}
+
+double LatencyHistogram::GetMean(void) const{
+    uint64_t n = GetCount();
+    return n == 0 ? 0 : (double)sum.load(std::memory_order_relaxed) / n;
+}
+
+uint64_t LatencyHistogram::GetPercentile(double percentile) const{
+    uint64_t n = GetCount();
+    if (n == 0) return 0;
+    uint64_t target = (uint64_t)std::ceil(percentile / 100.0 * n);
+    if (target < 1) target = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= target) {
+            uint64_t top = BucketTop(i);
+            return top < GetMax() ? top : GetMax();
+        }
+    }
+    return GetMax();
+}
+
+int LatencyHistogram::BucketOf(uint64_t value){
+    if (value < HISTOGRAM_SUB_BUCKETS) return (int)value;
+    int bit = 63 - __builtin_clzll(value);
+    if (bit > HISTOGRAM_MAX_BIT) return HISTOGRAM_BUCKETS - 1;
+    // Bit 4 and up: the 4 bits below the highest bit select the sub bucket
+    return (bit - 3) * HISTOGRAM_SUB_BUCKETS + (int)((value >> (bit - 4)) & (HISTOGRAM_SUB_BUCKETS - 1));
+}
+
+uint64_t LatencyHistogram::BucketTop(int bucket){
+    if (bucket < HISTOGRAM_SUB_BUCKETS) return (uint64_t)bucket;
+    int bit = bucket / HISTOGRAM_SUB_BUCKETS + 3;
+    uint64_t sub = (uint64_t)(bucket % HISTOGRAM_SUB_BUCKETS);
+    return ((HISTOGRAM_SUB_BUCKETS + sub + 1) << (bit - 4)) - 1;
+}
+
+void Gauge::Set(int64_t value){
+    current.store(value, std::memory_order_relaxed);
+    int64_t largest = max.load(std::memory_order_relaxed);
+    while (value > largest && !max.compare_exchange_weak(largest, value, std::memory_order_relaxed));
+}
+
+int64_t Gauge::Get(void) const{
+    return current.load(std::memory_order_relaxed);
+}
+
+int64_t Gauge::GetMax(void) const{
+    return max.load(std::memory_order_relaxed);
+}
+
+Metrics::Metrics(void){
+    start = std::chrono::steady_clock::now();
+    lastHalSample = start;
+}
+
+void Metrics::CommandDone(TaskCommandEnum command, uint64_t queueUs, uint64_t totalUs){
+    int index = (int)command;
+    if (index < 0 || index >= METRICS_COMMAND_COUNT) return;
+    commandQueue[index].Record(queueUs);
+    commandTotal[index].Record(totalUs);
+}
+
+void Metrics::StepDone(StepType type, uint64_t busyUs){
+    int index = (int)type;
+    if (index < 0 || index >= METRICS_STEP_TYPE_COUNT) return;
+    stepBusy[index].Record(busyUs);
+}
+
+void Metrics::SampleQueue(int steps, int groups){
+    queuedSteps.Set(steps);
+    usedGroups.Set(groups);
+}
+
+void Metrics::SampleInbox(int tasks){
+    inboxTasks.Set(tasks);
+}
+
+void Metrics::SampleHal(bool busy){
+    auto now = std::chrono::steady_clock::now();
+    uint64_t elapsed = ElapsedUs(lastHalSample, now);
+    if (lastHalBusy) halBusyUs.fetch_add(elapsed, std::memory_order_relaxed);
+    halSampledUs.fetch_add(elapsed, std::memory_order_relaxed);
+    lastHalSample = now;
+    lastHalBusy = busy;
+}
+
+std::string Metrics::Dump(void){
+    uint64_t uptime = ElapsedUs(start, std::chrono::steady_clock::now());
+    double seconds = uptime / 1e6;
+    uint64_t sampled = halSampledUs.load(std::memory_order_relaxed);
+    char number[64];
+    std::string out = "{\"uptimeUs\":" + std::to_string(uptime);
+
+    out += ",\"commands\":[";
+    bool first = true;
+    for (int i = 0; i < METRICS_COMMAND_COUNT; i++) {
+        if (commandTotal[i].GetCount() == 0) continue;
+        if (!first) out += ",";
+        first = false;
+        std::snprintf(number, sizeof(number), "%.3f", seconds > 0 ? commandTotal[i].GetCount() / seconds : 0.0);
+        out += "{\"command\":" + std::to_string(i) + ",\"perSecond\":" + number + ",\"queue\":";
+        DumpHistogram(out, commandQueue[i]);
+        out += ",\"total\":";
+        DumpHistogram(out, commandTotal[i]);
+        out += "}";
+    }
+
+    out += "],\"steps\":[";
+    first = true;
+    for (int i = 0; i < METRICS_STEP_TYPE_COUNT; i++) {
+        if (stepBusy[i].GetCount() == 0) continue;
+        if (!first) out += ",";
+        first = false;
+        out += "{\"step\":\"" + std::string(stepNames[i]) + "\",\"busy\":";
+        DumpHistogram(out, stepBusy[i]);
+        out += "}";
+    }
+
+    std::snprintf(number, sizeof(number), "%.4f", sampled > 0 ? (double)halBusyUs.load(std::memory_order_relaxed) / sampled : 0.0);
+    out += "],\"queue\":{\"steps\":" + std::to_string(queuedSteps.Get()) +
+        ",\"maxSteps\":" + std::to_string(queuedSteps.GetMax()) +
+        ",\"groups\":" + std::to_string(usedGroups.Get()) +
+        ",\"maxGroups\":" + std::to_string(usedGroups.GetMax()) +
+        ",\"inbox\":" + std::to_string(inboxTasks.Get()) +
+        ",\"maxInbox\":" + std::to_string(inboxTasks.GetMax()) +
+        "},\"hal\":{\"busyRatio\":" + number +
+        ",\"busyUs\":" + std::to_string(halBusyUs.load(std::memory_order_relaxed)) +
+        ",\"sampledUs\":" + std::to_string(sampled) + "}}";
+    return out;
+}
+
+void Metrics::DumpHistogram(std::string& out, const LatencyHistogram& histogram){
+    char mean[32];
+    std::snprintf(mean, sizeof(mean), "%.1f", histogram.GetMean());
+    out += "{\"count\":" + std::to_string(histogram.GetCount()) +
+        ",\"meanUs\":" + mean +
+        ",\"p50Us\":" + std::to_string(histogram.GetPercentile(50)) +
+        ",\"p90Us\":" + std::to_string(histogram.GetPercentile(90)) +
+        ",\"p99Us\":" + std::to_string(histogram.GetPercentile(99)) +
+        ",\"p999Us\":" + std::to_string(histogram.GetPercentile(99.9)) +
+        ",\"maxUs\":" + std::to_string(histogram.GetMax()) + "}";
+}
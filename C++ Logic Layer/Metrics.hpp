@@ -0,0 +1,191 @@
+/// \file       Metrics.hpp
+/// \brief      Header file for the Logic latency and throughput metrics
+///             Metrics keeps latency histograms per command and per step type, queue depth gauges
+///             and the HAL busy ratio. Recording only updates atomic counters.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "Step.hpp"
+#include "Task.h"
+#include "TaskCommands.hpp"
+
+/// \brief      Sub buckets per power of two, sets the histogram precision to about 6%
+#define HISTOGRAM_SUB_BUCKETS 16
+/// \brief      Highest bit of a recorded value, larger values are counted in the last bucket
+#define HISTOGRAM_MAX_BIT 40
+/// \brief      Number of histogram buckets
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_BIT - 2) * HISTOGRAM_SUB_BUCKETS)
+/// \brief      Number of commands with their own histograms, room for every protocol command
+#define METRICS_COMMAND_COUNT 32
+/// \brief      Number of step types
+#define METRICS_STEP_TYPE_COUNT ((int)StepType::NONE + 1)
+/// \brief      Number of started steps that can be timed at the same time
+#define METRICS_TIMED_STEPS 8
+
+static_assert(TASK_COMMAND_COUNT <= METRICS_COMMAND_COUNT, "METRICS_COMMAND_COUNT does not cover every command");
+
+/// \brief      Log-linear latency histogram
+/// \details    Values below HISTOGRAM_SUB_BUCKETS are counted exactly, every higher power of two
+///             is split into HISTOGRAM_SUB_BUCKETS buckets. Percentiles return the top of the
+///             bucket the percentile falls in. Record may be called from any thread.
+class LatencyHistogram
+{
+public:
+    /// \brief      Constructor
+    /// \pre        None
+    /// \post       Empty histogram
+    /// \returns    Nothing
+    LatencyHistogram(void);
+
+    /// \brief      Count a value
+    /// \pre        None
+    /// \post       Value added
+    /// \param[in]  value Latency in microseconds
+    /// \returns    Nothing
+    void Record(uint64_t value);
+
+    /// \brief      Get number of recorded values
+    /// \returns    Number of values
+    uint64_t GetCount(void) const;
+
+    /// \brief      Get largest recorded value
+    /// \returns    Largest value, 0 if empty
+    uint64_t GetMax(void) const;
+
+    /// \brief      Get average of the recorded values
+    /// \returns    Average, 0 if empty
+    double GetMean(void) const;
+
+    /// \brief      Get a percentile
+    /// \pre        None
+    /// \post       Nothing
+    /// \param[in]  percentile Percentile between 0 and 100
+    /// \returns    Upper bound of the values below the percentile, 0 if empty
+    uint64_t GetPercentile(double percentile) const;
+
+private:
+    /// \brief      Counts per bucket
+    std::atomic<uint64_t> buckets[HISTOGRAM_BUCKETS];
+    /// \brief      Number of values
+    std::atomic<uint64_t> count;
+    /// \brief      Sum of values
+    std::atomic<uint64_t> sum;
+    /// \brief      Largest value
+    std::atomic<uint64_t> max;
+
+    /// \brief      Get bucket of a value
+    static int BucketOf(uint64_t value);
+    /// \brief      Get largest value counted in a bucket
+    static uint64_t BucketTop(int bucket);
+};
+
+/// \brief      Current and highest value of a quantity
+class Gauge
+{
+public:
+    /// \brief      Set the current value
+    /// \param[in]  value New value
+    /// \returns    Nothing
+    void Set(int64_t value);
+
+    /// \brief      Get the current value
+    /// \returns    Current value
+    int64_t Get(void) const;
+
+    /// \brief      Get the highest value set
+    /// \returns    Highest value
+    int64_t GetMax(void) const;
+
+private:
+    std::atomic<int64_t> current{0};
+    std::atomic<int64_t> max{0};
+};
+
+/// \brief      Latency and throughput metrics of Logic
+/// \details    Commands are timed from receipt by Logic::callback. The queue time ends when the
+///             first step of the command runs, the total time when its last step has run.
+///             Step times are the time the HAL stays busy on the resources of the step.
+class Metrics
+{
+public:
+    /// \brief      Constructor
+    /// \pre        None
+    /// \post       Empty metrics, uptime starts now
+    /// \returns    Nothing
+    Metrics(void);
+
+    /// \brief      Count a finished command
+    /// \pre        None
+    /// \post       Command histograms updated
+    /// \param[in]  command Command of the task
+    /// \param[in]  queueUs Time from receipt until the first step ran
+    /// \param[in]  totalUs Time from receipt until the last step ran
+    /// \returns    Nothing
+    void CommandDone(TaskCommandEnum command, uint64_t queueUs, uint64_t totalUs);
+
+    /// \brief      Count a step that kept the HAL busy
+    /// \pre        None
+    /// \post       Step histogram updated
+    /// \param[in]  type Type of the step
+    /// \param[in]  busyUs Time the HAL was busy with the step
+    /// \returns    Nothing
+    void StepDone(StepType type, uint64_t busyUs);
+
+    /// \brief      Update the step queue depth gauges
+    /// \pre        None
+    /// \post       Gauges set
+    /// \param[in]  steps Steps in the step queue
+    /// \param[in]  groups Step groups in use
+    /// \returns    Nothing
+    void SampleQueue(int steps, int groups);
+
+    /// \brief      Update the event loop inbox gauge
+    /// \pre        None
+    /// \post       Gauge set
+    /// \param[in]  tasks Tasks waiting for the event loop
+    /// \returns    Nothing
+    void SampleInbox(int tasks);
+
+    /// \brief      Add the time since the last sample to the HAL busy or idle time
+    /// \pre        Called from one thread
+    /// \post       HAL time counters updated
+    /// \param[in]  busy True if the HAL is busy from now until the next sample
+    /// \returns    Nothing
+    void SampleHal(bool busy);
+
+    /// \brief      Get all metrics in machine readable form
+    /// \pre        None
+    /// \post       Nothing
+    /// \returns    JSON object
+    std::string Dump(void);
+
+private:
+    /// \brief      Time the metrics were created
+    std::chrono::steady_clock::time_point start;
+    /// \brief      Time from receipt until the first step ran, per command
+    LatencyHistogram commandQueue[METRICS_COMMAND_COUNT];
+    /// \brief      Time from receipt until the last step ran, per command
+    LatencyHistogram commandTotal[METRICS_COMMAND_COUNT];
+    /// \brief      Time the HAL was busy with a step, per step type
+    LatencyHistogram stepBusy[METRICS_STEP_TYPE_COUNT];
+    /// \brief      Steps in the step queue
+    Gauge queuedSteps;
+    /// \brief      Step groups in use
+    Gauge usedGroups;
+    /// \brief      Tasks waiting for the event loop
+    Gauge inboxTasks;
+    /// \brief      Time the HAL was busy and total sampled time
+    std::atomic<uint64_t> halBusyUs{0};
+    std::atomic<uint64_t> halSampledUs{0};
+    /// \brief      Time and state of the last HAL sample
+    std::chrono::steady_clock::time_point lastHalSample;
+    bool lastHalBusy = false;
+
+    /// \brief      Append a histogram to a dump
+    static void DumpHistogram(std::string& out, const LatencyHistogram& histogram);
+};
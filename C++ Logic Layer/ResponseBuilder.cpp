@@ -0,0 +1,37 @@
+/// \file       ResponseBuilder.cpp
+
+#include "ResponseBuilder.hpp"
+
+#include <utility>
+
+ResponseBuilder::ResponseBuilder(Task& request) :
+    ResponseBuilder(request, request.GetCommand()){
+}
+
+ResponseBuilder::ResponseBuilder(Task& request, TaskCommandEnum command) :
+    response(
+            request.GetMessageID(),
+            request.GetBlockID(),
+            request.GetPriority(),
+            command,
+            TaskTypeEnum::RESPONSEMESSAGE
+    ){
+}
+
+ResponseBuilder& ResponseBuilder::Result(Resultcodes code){
+    response.AddParameter(std::to_string((int)code));
+    return *this;
+}
+
+ResponseBuilder& ResponseBuilder::Add(std::string value){
+    response.AddParameter(std::move(value));
+    return *this;
+}
+
+void ResponseBuilder::Send(IQueueHandler& queueHandler){
+    queueHandler.AddTask(std::move(response));
+}
+
+Task ResponseBuilder::Take(void){
+    return std::move(response);
+}
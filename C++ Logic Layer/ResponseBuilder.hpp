@@ -0,0 +1,77 @@
+/// \file       ResponseBuilder.hpp
+/// \brief      Header file for building return messages
+///             ResponseBuilder creates the return message of a request once and hands it on by
+///             move, so its parameters are never copied.
+
+#pragma once
+
+#include <string>
+
+#include "Task.h"
+#include "IQueueHandler.h"
+
+/// \brief      Result codes sent as first parameter of a return message
+enum class Resultcodes {
+	Success = 0,
+	CommunicationError = -1,
+	UnknownMessage = -2,
+	ParameterCountError = -3,
+	InvalidParameter = -4,
+	ServerBusy = -5,
+	ActionNotPerformedDueToState = -6,
+	DrawersFull = -7,
+	FilterCombinationError = -8
+};
+
+/// \brief      Builds the return message of a request
+/// \details    The message gets the message id, block id and priority of the request. After
+///             Send() or Take() the builder holds a moved-from message and must not be used again.
+class ResponseBuilder
+{
+public:
+    /// \brief      Constructor for the response to a request
+    /// \pre        None
+    /// \post       Empty response message with the command of the request
+    /// \param[in]  request Request to answer
+    /// \returns    Nothing
+    ResponseBuilder(Task& request);
+
+    /// \brief      Constructor for a message with another command, used for callbacks
+    /// \pre        None
+    /// \post       Empty response message with the given command
+    /// \param[in]  request Request the message belongs to
+    /// \param[in]  command Command of the message
+    /// \returns    Nothing
+    ResponseBuilder(Task& request, TaskCommandEnum command);
+
+    /// \brief      Add the result code
+    /// \pre        No parameters added yet
+    /// \post       Result code added as parameter
+    /// \param[in]  code Result of the request
+    /// \returns    The builder
+    ResponseBuilder& Result(Resultcodes code);
+
+    /// \brief      Add a parameter
+    /// \pre        None
+    /// \post       Value moved into the message
+    /// \param[in]  value Parameter value
+    /// \returns    The builder
+    ResponseBuilder& Add(std::string value);
+
+    /// \brief      Hand the message to the queue handler
+    /// \pre        Message not taken or sent
+    /// \post       Message moved to the queue handler
+    /// \param[in]  queueHandler Queue handler sending the message
+    /// \returns    Nothing
+    void Send(IQueueHandler& queueHandler);
+
+    /// \brief      Take the message, used to queue it until its steps have run
+    /// \pre        Message not taken or sent
+    /// \post       Builder holds a moved-from message
+    /// \returns    The message
+    Task Take(void);
+
+private:
+    /// \brief      Message being built
+    Task response;
+};
@@ -0,0 +1,133 @@
+/// \file       RingBuffer.hpp
+/// \brief      Header file for fixed capacity ring buffer
+///             RingBuffer stores values inline in a fixed size array and never allocates after construction
+
+#pragma once
+
+#include <array>
+#include <utility>
+
+/// \brief      First in first out queue with a fixed capacity
+/// \details    Values are stored inline, pushing to a full buffer fails instead of growing.
+///             Positions passed to At are relative to the front of the queue.
+template <typename T, int Capacity>
+class RingBuffer
+{
+public:
+    /// \brief      Constructor
+    /// \pre        None
+    /// \post       Empty buffer
+    /// \returns    Nothing
+    RingBuffer(void) : head(0), count(0) {}
+
+    /// \brief      Add a value at the back
+    /// \pre        None
+    /// \post       Value moved into the buffer if there was room
+    /// \param[in]  value Value to add
+    /// \returns    True on success, false if the buffer is full
+    bool Push(T value) {
+        if (count >= Capacity) return false;
+        values[(head + count) % Capacity] = std::move(value);
+        count++;
+        return true;
+    }
+
+    /// \brief      Add a value at the front
+    /// \pre        None
+    /// \post       Value moved into the buffer if there was room, it is the next value popped
+    /// \param[in]  value Value to add
+    /// \returns    True on success, false if the buffer is full
+    bool PushFront(T value) {
+        if (count >= Capacity) return false;
+        head = (head + Capacity - 1) % Capacity;
+        values[head] = std::move(value);
+        count++;
+        return true;
+    }
+
+    /// \brief      Remove the value at the front
+    /// \pre        Buffer not empty
+    /// \post       Front slot reset to a default value
+    /// \returns    Nothing
+    void Pop(void) {
+        if (count == 0) return;
+        values[head] = T();
+        head = (head + 1) % Capacity;
+        count--;
+    }
+
+    /// \brief      Get the value at the front
+    /// \pre        Buffer not empty
+    /// \post       Nothing
+    /// \returns    Reference to the front value
+    T& Front(void) {
+        return values[head];
+    }
+
+    /// \brief      Get the value at the back
+    /// \pre        Buffer not empty
+    /// \post       Nothing
+    /// \returns    Reference to the last pushed value
+    T& Back(void) {
+        return values[(head + count - 1) % Capacity];
+    }
+
+    /// \brief      Get a value by position
+    /// \pre        position < Size()
+    /// \post       Nothing
+    /// \param[in]  position Position counted from the front
+    /// \returns    Reference to the value
+    T& At(int position) {
+        return values[(head + position) % Capacity];
+    }
+
+    /// \brief      Get a value by position
+    /// \pre        position < Size()
+    /// \post       Nothing
+    /// \param[in]  position Position counted from the front
+    /// \returns    Reference to the value
+    const T& At(int position) const {
+        return values[(head + position) % Capacity];
+    }
+
+    /// \brief      Remove values from the back until size values are left
+    /// \pre        None
+    /// \post       Removed slots reset to a default value
+    /// \param[in]  size Number of values to keep
+    /// \returns    Nothing
+    void Truncate(int size) {
+        while (count > size && count > 0) {
+            values[(head + count - 1) % Capacity] = T();
+            count--;
+        }
+    }
+
+    /// \brief      Remove all values
+    /// \pre        None
+    /// \post       Empty buffer
+    /// \returns    Nothing
+    void Clear(void) {
+        Truncate(0);
+        head = 0;
+    }
+
+    /// \brief      Check if the buffer is empty
+    /// \returns    True if no values are stored
+    bool Empty(void) const { return count == 0; }
+
+    /// \brief      Get number of stored values
+    /// \returns    Number of values
+    int Size(void) const { return count; }
+
+    /// \brief      Get number of values that can still be pushed
+    /// \returns    Free slots
+    int Free(void) const { return Capacity - count; }
+
+private:
+    /// \brief      Storage for the values
+    std::array<T, Capacity> values;
+    /// \brief      Slot of the front value
+    int head;
+    /// \brief      Number of stored values
+    int count;
+};
@@ -0,0 +1,153 @@
+/// \file       SimHal.cpp
+
+#include "SimHal.hpp"
+
+#include <cstdlib>
+
+/// \brief      Resource slot of the crane
+static const int craneSlot = 0;
+/// \brief      Resource slot of the magnet
+static const int magnetSlot = 1;
+/// \brief      Resource slot of drawer 0
+static const int firstDrawerSlot = 2;
+
+SimHal::SimHal(int drawerCount, int craneRange, SimHalTiming timing){
+    this->drawerCount = drawerCount < HalResourceMaxDrawer + 1 ? drawerCount : HalResourceMaxDrawer + 1;
+    this->craneRange = craneRange;
+    this->timing = timing;
+    status = HalStatus::IDLE;
+    initialized = false;
+    now = 0;
+    for(int i = 0; i < simResourceCount; i++) busyUntil[i] = 0;
+    crane = 0;
+    magnet = 0;
+    openDrawers = 0;
+}
+
+void SimHal::init(void){
+    initialized = true;
+    status = HalStatus::IDLE;
+    for(int i = 0; i < simResourceCount; i++) busyUntil[i] = now;
+}
+
+void SimHal::de_init(void){
+    initialized = false;
+}
+
+void SimHal::run(void){
+    if(status != HalStatus::BUSY) return;
+    // Jump to the next operation that finishes
+    uint64_t next = 0;
+    for(int i = 0; i < simResourceCount; i++){
+        if(busyUntil[i] > now && (next == 0 || busyUntil[i] < next)) next = busyUntil[i];
+    }
+    if(next > now) Advance(next - now);
+}
+
+void SimHal::setStatusCallback(std::function<void(void)> callback){
+    statusCallback = callback;
+}
+
+HalStatus SimHal::getStatus(void){
+    return status;
+}
+
+bool SimHal::tracksResources(void){
+    return true;
+}
+
+bool SimHal::isBusy(uint64_t resources){
+    for(int i = 0; i < simResourceCount; i++){
+        if((resources & ((uint64_t)1 << i)) && busyUntil[i] > now) return true;
+    }
+    return false;
+}
+
+void SimHal::openDrawer(int drawer){
+    bool valid = drawer >= 0 && drawer < drawerCount;
+    if(!Start(valid, timing.drawerOpenUs, firstDrawerSlot + drawer)) return;
+    openDrawers |= (uint64_t)1 << drawer;
+}
+
+int SimHal::closeDrawer(int drawer){
+    if(drawer < 0 || drawer >= drawerCount) return -1;
+    uint64_t bit = (uint64_t)1 << drawer;
+    if((openDrawers & bit) == 0) return 0;
+    if(!Start(true, timing.drawerCloseUs, firstDrawerSlot + drawer)) return -1;
+    openDrawers &= ~bit;
+    return 0;
+}
+
+void SimHal::closeAllDrawers(void){
+    if(openDrawers == 0) return;
+    if(status == HalStatus::ERROR) return;
+    if(!initialized){
+        status = HalStatus::ERROR;
+        statistics.errorCount++;
+        return;
+    }
+    // All extended drawers retract together and finish with the slowest one
+    uint64_t start = now;
+    for(int drawer = 0; drawer < drawerCount; drawer++){
+        int slot = firstDrawerSlot + drawer;
+        if((openDrawers & ((uint64_t)1 << drawer)) && busyUntil[slot] > start) start = busyUntil[slot];
+    }
+    for(int drawer = 0; drawer < drawerCount; drawer++){
+        if(openDrawers & ((uint64_t)1 << drawer)) busyUntil[firstDrawerSlot + drawer] = start + timing.drawerCloseUs;
+    }
+    statistics.operationCount++;
+    openDrawers = 0;
+    if(timing.drawerCloseUs > 0 || start > now) status = HalStatus::BUSY;
+}
+
+void SimHal::setMagnet(int state){
+    if(!Start(true, state == magnet ? 0 : timing.magnetUs, magnetSlot)) return;
+    magnet = state;
+}
+
+void SimHal::moveCrane(int position){
+    bool valid = position >= 0 && position <= craneRange;
+    uint64_t distance = valid ? (uint64_t)std::abs(position - crane) : 0;
+    if(!Start(valid, timing.craneStartUs + distance * timing.craneUsPerUnit, craneSlot)) return;
+    statistics.craneTravel += distance;
+    crane = position;
+}
+
+void SimHal::Advance(uint64_t us){
+    uint64_t end = now + us;
+    uint64_t last = now;
+    bool finished = false;
+    for(int i = 0; i < simResourceCount; i++){
+        if(busyUntil[i] <= now) continue;
+        if(busyUntil[i] <= end) finished = true;
+        uint64_t busyEnd = end < busyUntil[i] ? end : busyUntil[i];
+        if(busyEnd > last) last = busyEnd;
+    }
+    statistics.busyUs += last - now;
+    now = end;
+    if(status == HalStatus::BUSY && !isBusy(HalResourceAll)) status = HalStatus::IDLE;
+    if(finished && statusCallback) statusCallback();
+}
+
+uint64_t SimHal::GetTime(void){
+    return now;
+}
+
+SimHalStatistics SimHal::GetStatistics(void){
+    return statistics;
+}
+
+bool SimHal::Start(bool valid, uint64_t latency, int slot){
+    if(status == HalStatus::ERROR) return false;
+    if(!initialized || !valid){
+        status = HalStatus::ERROR;
+        statistics.errorCount++;
+        return false;
+    }
+    statistics.operationCount++;
+    // An operation on a busy resource runs after the running one
+    uint64_t start = busyUntil[slot] > now ? busyUntil[slot] : now;
+    busyUntil[slot] = start + latency;
+    if(busyUntil[slot] > now) status = HalStatus::BUSY;
+    return true;
+}
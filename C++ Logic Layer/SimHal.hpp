@@ -0,0 +1,112 @@
+/// \file       SimHal.hpp
+/// \brief      Header file for the simulated HAL
+///             SimHal implements IHal without hardware. Operations take time on a simulated clock,
+///             so runs are deterministic and do not depend on the speed of the host.
+
+#pragma once
+
+#include <cstdint>
+
+#include "IHal.hpp"
+
+/// \brief      Latencies of simulated operations in microseconds
+typedef struct {
+    uint64_t craneStartUs = 500000;     ///< Fixed part of a crane move
+    uint64_t craneUsPerUnit = 50000;    ///< Crane move time per position unit
+    uint64_t drawerOpenUs = 2000000;    ///< Extending a drawer
+    uint64_t drawerCloseUs = 2000000;   ///< Retracting an open drawer
+    uint64_t magnetUs = 200000;         ///< Switching the magnet
+}SimHalTiming;
+
+/// \brief      Number of simulated resources, crane, magnet and one per drawer
+static const int simResourceCount = HalResourceMaxDrawer + 3;
+
+/// \brief      Counters of the simulated HAL
+typedef struct {
+    uint64_t operationCount = 0;        ///< Number of operations started
+    uint64_t craneTravel = 0;           ///< Total crane travel in position units
+    uint64_t busyUs = 0;                ///< Simulated time with at least one operation running
+    uint64_t errorCount = 0;            ///< Number of operations that set the ERROR state
+}SimHalStatistics;
+
+/// \brief      Simulated cabinet hardware
+/// \details    The crane, the magnet and every drawer are separate resources. An operation keeps its
+///             resource busy until its latency has passed on the simulated clock, operations on
+///             different resources overlap. An operation on a busy resource runs after the running
+///             one. run() advances the clock to the end of the first running operation, Advance()
+///             can be used instead to step the clock by a fixed amount. Starting an operation before
+///             init(), on a drawer that does not exist or outside the crane range sets ERROR.
+///             closeAllDrawers() retracts the extended drawers with one batched operation.
+class SimHal : public IHal
+{
+public:
+    /// \brief      Constructor
+    /// \pre        None
+    /// \post       Idle HAL, not initialized, all drawers retracted, crane at position 0
+    /// \param[in]  drawerCount Number of drawers, drawers are numbered from 0
+    /// \param[in]  craneRange Highest crane position
+    /// \param[in]  timing Operation latencies
+    /// \returns    Nothing
+    SimHal(int drawerCount, int craneRange, SimHalTiming timing = SimHalTiming());
+
+    void init(void) override;
+    void de_init(void) override;
+    void run(void) override;
+    void setStatusCallback(std::function<void(void)> callback) override;
+    HalStatus getStatus(void) override;
+    bool tracksResources(void) override;
+    bool isBusy(uint64_t resources) override;
+    void openDrawer(int drawer) override;
+    int closeDrawer(int drawer) override;
+    void closeAllDrawers(void) override;
+    void setMagnet(int state) override;
+    void moveCrane(int position) override;
+
+    /// \brief      Advance the simulated clock
+    /// \pre        None
+    /// \post       Running operation finished if its end has been reached
+    /// \param[in]  us Microseconds to advance
+    /// \returns    Nothing
+    void Advance(uint64_t us);
+
+    /// \brief      Get the simulated clock
+    /// \pre        None
+    /// \post       Nothing
+    /// \returns    Microseconds since construction
+    uint64_t GetTime(void);
+
+    /// \brief      Get simulator counters
+    /// \pre        None
+    /// \post       Nothing
+    /// \returns    Copy of the counters
+    SimHalStatistics GetStatistics(void);
+
+private:
+    /// \brief      Number of drawers
+    int drawerCount;
+    /// \brief      Highest crane position
+    int craneRange;
+    /// \brief      Operation latencies
+    SimHalTiming timing;
+    /// \brief      Current state
+    HalStatus status;
+    /// \brief      False before init() and after de_init()
+    bool initialized;
+    /// \brief      Simulated clock in microseconds
+    uint64_t now;
+    /// \brief      End of the last operation per resource: crane, magnet, drawer 0 and up
+    uint64_t busyUntil[simResourceCount];
+    /// \brief      Crane position
+    int crane;
+    /// \brief      Magnet state
+    int magnet;
+    /// \brief      Bit per open drawer
+    uint64_t openDrawers;
+    /// \brief      Counters
+    SimHalStatistics statistics;
+    /// \brief      Called when an operation finishes
+    std::function<void(void)> statusCallback;
+
+    /// \brief      Start an operation on a resource slot, false and ERROR state if it can not be started
+    bool Start(bool valid, uint64_t latency, int slot);
+};
@@ -0,0 +1,192 @@
+/// \file       Slab.hpp
+/// \brief      Header file for slab storage
+///             Slab stores records in fixed size contiguous blocks and hands out stable integer handles
+
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+/// \brief      Handle value that never refers to a record
+static const int InvalidHandle = -1;
+
+/// \brief      Block based record store with stable handles
+/// \details    Records are stored inline in blocks of BlockSize entries. Blocks are never moved,
+///             so both handles and pointers stay valid until the record is released.
+///             Released slots are reused through a free list.
+template <typename T, int BlockSize = 64>
+class Slab
+{
+public:
+    /// \brief      Constructor
+    /// \pre        None
+    /// \post       Empty slab without blocks
+    /// \returns    Nothing
+    Slab(void) : count(0), freeList(InvalidHandle) {}
+
+    /// \brief      Store a copy of a record
+    /// \pre        None
+    /// \post       Record stored in a free slot, new block allocated if needed
+    /// \param[in]  value Record to store
+    /// \returns    Handle of the stored record
+    int Allocate(const T& value) {
+        if (freeList == InvalidHandle) Grow();
+        int handle = freeList;
+        Slot& slot = SlotAt(handle);
+        freeList = slot.nextFree;
+        slot.value = value;
+        slot.used = true;
+        slot.nextFree = InvalidHandle;
+        count++;
+        return handle;
+    }
+
+    /// \brief      Release a record
+    /// \pre        None
+    /// \post       Slot cleared and added to the free list
+    /// \param[in]  handle Handle of record to release
+    /// \returns    0 on success, -1 if the handle does not refer to a record
+    int Release(int handle) {
+        if (Get(handle) == NULL) return -1;
+        Slot& slot = SlotAt(handle);
+        slot.value = T();
+        slot.used = false;
+        slot.nextFree = freeList;
+        freeList = handle;
+        count--;
+        return 0;
+    }
+
+    /// \brief      Get record by handle
+    /// \pre        None
+    /// \post       Nothing
+    /// \param[in]  handle Handle of record
+    /// \returns    Record pointer on success, NULL if the handle does not refer to a record
+    T* Get(int handle) {
+        if (handle < 0 || handle >= Capacity()) return NULL;
+        Slot& slot = SlotAt(handle);
+        return slot.used ? &slot.value : NULL;
+    }
+
+    /// \brief      Get record by handle
+    /// \pre        None
+    /// \post       Nothing
+    /// \param[in]  handle Handle of record
+    /// \returns    Record pointer on success, NULL if the handle does not refer to a record
+    const T* Get(int handle) const {
+        if (handle < 0 || handle >= Capacity()) return NULL;
+        const Slot& slot = SlotAt(handle);
+        return slot.used ? &slot.value : NULL;
+    }
+
+    /// \brief      Get number of stored records
+    /// \pre        None
+    /// \post       Nothing
+    /// \returns    Number of records
+    int Count(void) const {
+        return count;
+    }
+
+    /// \brief      Get number of slots in all allocated blocks
+    /// \pre        None
+    /// \post       Nothing
+    /// \returns    Number of slots
+    int Capacity(void) const {
+        return (int)blocks.size() * BlockSize;
+    }
+
+    /// \brief      Release all records and blocks
+    /// \pre        None
+    /// \post       Empty slab without blocks
+    /// \returns    Nothing
+    void Clear(void) {
+        blocks.clear();
+        count = 0;
+        freeList = InvalidHandle;
+    }
+
+    /// \brief      Read-only forward iterator over stored records, skips free slots
+    class Iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const T* pointer;
+        typedef const T& reference;
+
+        Iterator(const Slab* slab, int handle) : slab(slab), handle(handle) { Skip(); }
+        const T& operator*() const { return *slab->Get(handle); }
+        const T* operator->() const { return slab->Get(handle); }
+        Iterator& operator++() { handle++; Skip(); return *this; }
+        Iterator operator++(int) { Iterator it = *this; ++(*this); return it; }
+        bool operator==(const Iterator& other) const { return handle == other.handle; }
+        bool operator!=(const Iterator& other) const { return handle != other.handle; }
+        /// \brief      Handle of the record the iterator points to
+        int Handle(void) const { return handle; }
+
+    private:
+        const Slab* slab;
+        int handle;
+        void Skip(void) {
+            while (handle < slab->Capacity() && slab->Get(handle) == NULL) handle++;
+        }
+    };
+
+    /// \brief      Read-only range over stored records, valid until the slab is modified
+    class View
+    {
+    public:
+        View(const Slab* slab) : slab(slab) {}
+        Iterator begin(void) const { return Iterator(slab, 0); }
+        Iterator end(void) const { return Iterator(slab, slab->Capacity()); }
+        int size(void) const { return slab->Count(); }
+        bool empty(void) const { return slab->Count() == 0; }
+
+    private:
+        const Slab* slab;
+    };
+
+    /// \brief      Get read-only view on all stored records
+    /// \pre        None
+    /// \post       Nothing
+    /// \returns    View iterating records in handle order
+    View GetView(void) const {
+        return View(this);
+    }
+
+private:
+    /// \brief      Storage slot for one record
+    struct Slot {
+        T value;
+        bool used = false;
+        int nextFree = InvalidHandle;
+    };
+    /// \brief      Blocks of slots, never moved once allocated
+    std::vector<std::unique_ptr<Slot[]>> blocks;
+    /// \brief      Number of used slots
+    int count;
+    /// \brief      First free slot, InvalidHandle if all slots are used
+    int freeList;
+
+    /// \brief      Get slot by handle, handle must be in range
+    Slot& SlotAt(int handle) {
+        return blocks[handle / BlockSize][handle % BlockSize];
+    }
+    const Slot& SlotAt(int handle) const {
+        return blocks[handle / BlockSize][handle % BlockSize];
+    }
+
+    /// \brief      Allocate a new block and add its slots to the free list in ascending order
+    void Grow(void) {
+        int first = Capacity();
+        blocks.emplace_back(new Slot[BlockSize]);
+        for (int i = BlockSize - 1; i >= 0; i--) {
+            Slot& slot = blocks.back()[i];
+            slot.nextFree = freeList;
+            freeList = first + i;
+        }
+    }
+};
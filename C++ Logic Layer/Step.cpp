@@ -1,85 +1,107 @@
 /// \file       Step.cpp
 
 #include "Step.hpp"
-#include "Logging.hpp"
+#include "FastLog.hpp"
+
+#include <utility>
+
+Step::Step(void){
+    type = StepType::NONE;
+    intParam = 0;
+    task = NULL;
+}
 
 Step::Step(StepType type){
-    Logging::LogEnterFunction(__FUNCTION__, "");
+    LOG_ENTER();
     this->type = type;
+    intParam = 0;
+    task = NULL;
 }
 
 Step::Step(StepType type, Task* task){
-    Logging::LogEnterFunction(__FUNCTION__, "");
+    LOG_ENTER();
     this->type = type;
+    intParam = 0;
     this->task = task;
 }
 
 Step::Step(StepType type, int param){
-    Logging::LogEnterFunction(__FUNCTION__, "");
+    LOG_ENTER();
     this->type = type;
     intParam = param;
+    task = NULL;
 }
 
-Step::Step(StepType type, std::string param){
-    Logging::LogEnterFunction(__FUNCTION__, "");
-    this->type = type;
-    stringParam = param;
+StepType Step::GetType() const{
+    LOG_ENTER();
+    return type;
 }
 
-Step::Step(StepType type, int iparam, std::string sparam){
-    Logging::LogEnterFunction(__FUNCTION__, "");
-    this->type = type;
-    intParam = iparam;
-    stringParam = sparam;
+int Step::GetParam() const{
+    return intParam;
 }
 
-Step::~Step(void){
-    Logging::LogEnterFunction(__FUNCTION__, "");
-
+uint64_t Step::GetWaitResources() const{
+    switch(type){
+        case StepType::CRANE_MOVE:
+            return HalResourceCrane | HalResourceMagnet;
+        case StepType::DRAWER_EXTEND:
+            return HalResourceDrawer(intParam) | HalResourceCrane;
+        case StepType::ALL_DRAWERS_RETRACT:
+            return HalResourceDrawers | HalResourceCrane | HalResourceMagnet;
+        case StepType::NONE:
+            return 0;
+        default:
+            return HalResourceAll;
+    }
 }
 
-StepType Step::GetType(){
-    Logging::LogEnterFunction(__FUNCTION__, "");
-    return type;
+bool Step::MovesCabinet() const{
+    switch(type){
+        case StepType::DRAWER_EXTEND:
+        case StepType::ALL_DRAWERS_RETRACT:
+        case StepType::CRANE_MOVE:
+        case StepType::MAGNET:
+            return true;
+        default:
+            return false;
+    }
 }
 
-bool Step::DoStep(Hal& hal, Database& database, IQueueHandler& queueHandler){
-    Logging::LogEnterFunction(__FUNCTION__, "");
-    int ret = 0;
-    int drawer = 0;
-
+bool Step::DoStep(IHal& hal, Database& database, IQueueHandler& queueHandler){
+    LOG_ENTER();
     switch(type){
         case StepType::DRAWER_EXTEND:
-			Logging::LogEvent((int)LogLevels::LogDebug, "Logic > DoStep > DRAWER_EXTEND");
+			LOG_DEBUG("Logic > DoStep > DRAWER_EXTEND");
             hal.openDrawer(intParam);
             return true;
         case StepType::ALL_DRAWERS_RETRACT:
-			Logging::LogEvent((int)LogLevels::LogDebug, "Logic > DoStep > ALL_DRAWERS_RETRACT");
-            while(ret == 0){
-                ret = hal.closeDrawer(drawer);
-                drawer++;
-            }
+			LOG_DEBUG("Logic > DoStep > ALL_DRAWERS_RETRACT");
+            hal.closeAllDrawers();
             return true;
         case StepType::MAGNET:
-			Logging::LogEvent((int)LogLevels::LogDebug, "Logic > DoStep > MAGNET");
+			LOG_DEBUG("Logic > DoStep > MAGNET");
             hal.setMagnet(intParam);
             return true;
             case StepType::CRANE_MOVE:
-			Logging::LogEvent((int)LogLevels::LogDebug, "Logic > DoStep > CRANE_MOVE");
+			LOG_DEBUG("Logic > DoStep > CRANE_MOVE");
             hal.moveCrane(intParam);
             return true;
         case StepType::SEND_RETURN_MESSAGE:
-			Logging::LogEvent((int)LogLevels::LogDebug, "Logic > DoStep > SEND_RETURN_MESSAGE");
-            queueHandler.AddTask(*task);
+			LOG_DEBUG("Logic > DoStep > SEND_RETURN_MESSAGE");
+            // The message is released once this step has run, move it to the queue handler
+            queueHandler.AddTask(std::move(*task));
             return false;
         case StepType::STOP_HAL:
-			Logging::LogEvent((int)LogLevels::LogDebug, "Logic > DoStep > STOP_HAL");
+			LOG_DEBUG("Logic > DoStep > STOP_HAL");
             hal.de_init();
             return true;
 		case StepType::START_HAL:
-			Logging::LogEvent((int)LogLevels::LogDebug, "Logic > DoStep > START_HAL");
+			LOG_DEBUG("Logic > DoStep > START_HAL");
 			hal.init();
 			return true;
+		case StepType::NONE:
+			return false;
     }
     return false;
 }
@@ -7,7 +7,7 @@
 
 #include "Error.h"
 #include "MessageParameter.h"
-#include "hal.hpp"
+#include "IHal.hpp"
 #include "Database.hpp"
 #include "Task.h"
 #include "IQueueHandler.h"
@@ -21,13 +21,22 @@ enum class StepType
     MAGNET,                     ///< Set magnet state
     SEND_RETURN_MESSAGE,        ///< Sends a return message to the client
     STOP_HAL,                   ///< Sends stop signal to HAL
-	START_HAL                   ///< Sends stop signal to HAL
+	START_HAL,                  ///< Sends stop signal to HAL
+	NONE                        ///< Does nothing, used for unused queue slots
 };
 
 /// \brief Small task to execute in a short amount of time
+/// \details Steps are small values stored inline in the step queue. A return message step only
+///          points to its task, the task itself is owned by the response queue of Logic.
 class Step
 {
 public:
+    /// \brief      Constructor for an empty step
+    /// \pre        None.
+    /// \post       Step of type NONE.
+    /// \returns    Nothing
+    Step(void);
+
     /// \brief      Constructor without parameter
     /// \pre        None.
     /// \post       Initialized step object with task parameter.
@@ -39,7 +48,7 @@ public:
     /// \pre        None.
     /// \post       Initialized step object with task parameter.
     /// \param[in]  type Defines the type of step
-    /// \param[in]  task Task parameter to use
+    /// \param[in]  task Task parameter to use, not owned by the step
     /// \returns    Nothing
     Step(StepType type, Task* task);
 
@@ -51,34 +60,33 @@ public:
     /// \returns    Nothing
     Step(StepType type, int param);
 
-    /// \brief      Constructor with string parameter
+    /// \brief      Get the step type of this step object
     /// \pre        None.
-    /// \post       Initialized step object with int parameter.
-    /// \param[in]  type Defines the type of step
-    /// \param[in]  param String parameter to use
-    /// \returns    Nothing
-    Step(StepType type, std::string param);
+    /// \post       None.
+    /// \returns    Step type
+    StepType GetType(void) const;
 
-    /// \brief      Constructor with string and int parameter
+    /// \brief      Get the integer parameter of this step object
     /// \pre        None.
-    /// \post       Initialized step object with int parameter.
-    /// \param[in]  type Defines the type of step
-    /// \param[in]  iparam Integer parameter to use
-    /// \param[in]  sparam String parameter to use
-    /// \returns    Nothing
-    Step(StepType type, int iparam, std::string sparam);
+    /// \post       None.
+    /// \returns    Drawer, crane position or magnet state, 0 for steps without parameter
+    int GetParam(void) const;
 
-    /// \brief      Destructor
-    /// \pre        None
-    /// \post       Clean step object
-    /// \returns    Nothing
-    ~Step(void);
+    /// \brief      Get the HAL resources that have to be idle before this step can start
+    /// \pre        None.
+    /// \post       None.
+    /// \details    A crane move waits for the crane and the magnet. Drawer extends and retracts
+    ///             wait for the crane, so drawers only move with the crane at rest. A retract also
+    ///             waits for the drawers and the magnet. The magnet, return messages and HAL
+    ///             start and stop wait for everything, so they see the result of all earlier steps.
+    /// \returns    Resource bits, see IHal.hpp
+    uint64_t GetWaitResources(void) const;
 
-    /// \brief      Get the step type of this step object
+    /// \brief      Check if the step moves the crane, the magnet or a drawer
     /// \pre        None.
     /// \post       None.
-    /// \returns    Step type
-    StepType GetType(void);
+    /// \returns    True for steps that need an initialized HAL without errors
+    bool MovesCabinet(void) const;
 
     /// \brief      Execute the step
     /// \pre        None.
@@ -87,7 +95,7 @@ public:
     /// \param[in]  database Reference to database for storing filter information.
     /// \param[in]  queueHandler Reference to queueHandler.
     /// \returns    True if the step used a HAL function that needs waiting for, false if no waiting is needed.
-    bool DoStep(Hal& hal, Database& database, IQueueHandler& queueHandler);
+    bool DoStep(IHal& hal, Database& database, IQueueHandler& queueHandler);
 
 private:
     /// \brief      Stores step's type
@@ -96,6 +104,4 @@ private:
     int intParam;
     /// \brief      Task for return message
     Task* task;
-    /// \brief      Stores string parameter
-    std::string stringParam;
 };
\ No newline at end of file
@@ -0,0 +1,99 @@
+/// \file       StepOptimizer.cpp
+
+#include "StepOptimizer.hpp"
+
+#include <cstdlib>
+
+/// \brief      Number of drawers that fit in the drawer bit mask
+static const int maxTrackedDrawer = 31;
+
+StepOptimizer::StepOptimizer(void){
+    Reset();
+}
+
+StepAction StepOptimizer::Check(const Step& step, bool canMerge){
+    statistics.stepsChecked++;
+    int origin = moveOrigin;
+    moveOrigin = Unknown;
+    int param = step.GetParam();
+
+    switch(step.GetType()){
+        case StepType::CRANE_MOVE:
+            if(crane == param){
+                moveOrigin = origin;
+                Removed(CraneSecondsPerMove);
+                return StepAction::DROP;
+            }
+            if(canMerge && origin != Unknown){
+                // Previous step is a move that has not started, go straight to the new target
+                Removed(MoveSeconds(origin, crane) + MoveSeconds(crane, param) - MoveSeconds(origin, param));
+                statistics.craneTravel -= std::abs(crane - origin);
+                statistics.craneTravel += std::abs(param - origin);
+                crane = param;
+                moveOrigin = origin;
+                return StepAction::REPLACE_LAST;
+            }
+            if(crane != Unknown) statistics.craneTravel += std::abs(param - crane);
+            moveOrigin = crane;
+            crane = param;
+            return StepAction::KEEP;
+        case StepType::MAGNET:
+            if(magnet == param){
+                moveOrigin = origin;
+                Removed(MagnetSeconds);
+                return StepAction::DROP;
+            }
+            magnet = param;
+            return StepAction::KEEP;
+        case StepType::DRAWER_EXTEND:
+            if(param < 0 || param > maxTrackedDrawer){
+                drawersKnown = false;
+                return StepAction::KEEP;
+            }
+            if(drawersKnown && (openDrawers & (1u << param))){
+                moveOrigin = origin;
+                Removed(DrawerSeconds);
+                return StepAction::DROP;
+            }
+            openDrawers |= 1u << param;
+            return StepAction::KEEP;
+        case StepType::ALL_DRAWERS_RETRACT:
+            if(drawersKnown && openDrawers == 0){
+                moveOrigin = origin;
+                Removed(DrawerSeconds);
+                return StepAction::DROP;
+            }
+            openDrawers = 0;
+            drawersKnown = true;
+            return StepAction::KEEP;
+        case StepType::STOP_HAL:
+        case StepType::START_HAL:
+            Reset();
+            return StepAction::KEEP;
+        case StepType::SEND_RETURN_MESSAGE:
+        case StepType::NONE:
+            return StepAction::KEEP;
+    }
+    return StepAction::KEEP;
+}
+
+void StepOptimizer::Reset(void){
+    crane = Unknown;
+    moveOrigin = Unknown;
+    magnet = Unknown;
+    openDrawers = 0;
+    drawersKnown = false;
+}
+
+OptimizerStatistics StepOptimizer::GetStatistics(void){
+    return statistics;
+}
+
+double StepOptimizer::MoveSeconds(int from, int to){
+    return CraneSecondsPerMove + std::abs(to - from) * CraneSecondsPerUnit;
+}
+
+void StepOptimizer::Removed(double seconds){
+    statistics.stepsRemoved++;
+    statistics.secondsSaved += seconds;
+}
@@ -0,0 +1,92 @@
+/// \file       StepOptimizer.hpp
+/// \brief      Header file for the step peephole optimizer
+///             StepOptimizer follows the state the cabinet will have after all queued steps and
+///             removes steps that would not change that state.
+
+#pragma once
+
+#include <cstdint>
+
+#include "Step.hpp"
+
+/// \brief      Estimated seconds of crane travel per position unit
+static const double CraneSecondsPerUnit = 0.05;
+/// \brief      Estimated seconds to start and stop a crane move
+static const double CraneSecondsPerMove = 0.5;
+/// \brief      Estimated seconds to extend a drawer or retract all drawers
+static const double DrawerSeconds = 2.0;
+/// \brief      Estimated seconds to switch the magnet
+static const double MagnetSeconds = 0.2;
+
+/// \brief      What to do with a step offered to the optimizer
+enum class StepAction
+{
+    KEEP,                       ///< Append step to the queue
+    DROP,                       ///< Step does not change state, do not queue it
+    REPLACE_LAST                ///< Step replaces the last queued step, a crane move
+};
+
+/// \brief      Counters of the step optimizer
+typedef struct {
+    uint64_t stepsChecked = 0;          ///< Number of steps offered
+    uint64_t stepsRemoved = 0;          ///< Number of steps dropped or merged
+    double secondsSaved = 0;            ///< Estimated actuator time saved
+    uint64_t craneTravel = 0;           ///< Crane travel of the queued moves, in position units
+}OptimizerStatistics;
+
+/// \brief      Peephole optimizer for the step queue
+/// \details    Steps are checked one at a time in queue order. A crane move to the current
+///             position, a magnet switch to the current state, a drawer extend of an open drawer
+///             and a retract while all drawers are closed are dropped. Two crane moves without
+///             another step in between are merged into one move. State starts unknown, so
+///             nothing is dropped until a step has set it.
+class StepOptimizer
+{
+public:
+    /// \brief      Constructor
+    /// \pre        None
+    /// \post       Optimizer with unknown cabinet state
+    /// \returns    Nothing
+    StepOptimizer(void);
+
+    /// \brief      Check a step before it is queued
+    /// \pre        Steps are offered in the order they are queued
+    /// \post       Tracked state updated as if the step was queued
+    /// \param[in]  step Step to check
+    /// \param[in]  canMerge True if the last offered step is still waiting in the queue
+    /// \returns    Action for the step
+    StepAction Check(const Step& step, bool canMerge);
+
+    /// \brief      Forget the tracked state, used when the hardware state is unknown
+    /// \pre        None
+    /// \post       Nothing is dropped until state has been set by new steps
+    /// \returns    Nothing
+    void Reset(void);
+
+    /// \brief      Get optimizer counters
+    /// \pre        None
+    /// \post       Nothing
+    /// \returns    Copy of the counters
+    OptimizerStatistics GetStatistics(void);
+
+private:
+    /// \brief      Value for crane position and magnet state when unknown
+    static const int Unknown = -1;
+    /// \brief      Crane position after the queued steps
+    int crane;
+    /// \brief      Crane position before the last queued step if that step is a crane move
+    int moveOrigin;
+    /// \brief      Magnet state after the queued steps
+    int magnet;
+    /// \brief      Bit per open drawer after the queued steps
+    uint32_t openDrawers;
+    /// \brief      False if openDrawers can not be trusted
+    bool drawersKnown;
+    /// \brief      Counters
+    OptimizerStatistics statistics;
+
+    /// \brief      Estimated seconds of a crane move
+    static double MoveSeconds(int from, int to);
+    /// \brief      Count a removed step
+    void Removed(double seconds);
+};
@@ -0,0 +1,203 @@
+/// \file       StepRecipe.hpp
+/// \brief      Header file for the fixed step recipes of the cabinet commands
+///             A recipe is a constant table of steps whose parameters refer to the drawer and stack
+///             slot of a command. Queueing a recipe copies the table into the step queue, the
+///             recipes are checked at compile time.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "Step.hpp"
+
+/// \brief      Source of the parameter of a recipe step
+enum class RecipeArgument : uint8_t
+{
+    NONE,                       ///< Step has no parameter
+    VALUE,                      ///< Constant value of the recipe step
+    HOME,                       ///< Crane home position
+    INTAKE,                     ///< Crane position of the intake drawer
+    DRAWER,                     ///< Drawer of the command
+    DRAWER_POSITION,            ///< Crane position of the drawer of the command
+    SLOT_POSITION               ///< Crane position of the stack slot of the command
+};
+
+/// \brief      One entry of a recipe
+typedef struct {
+    StepType type;                      ///< Type of the step
+    RecipeArgument argument;            ///< Source of the step parameter
+    int value;                          ///< Parameter for RecipeArgument::VALUE
+}RecipeStep;
+
+/// \brief      Values the recipe arguments are resolved to when a recipe is queued
+typedef struct {
+    int home;                           ///< Crane home position
+    int intake;                         ///< Crane position of the intake drawer
+    int drawer;                         ///< Drawer of the command
+    int drawerPosition;                 ///< Crane position of the drawer
+    int slotPosition;                   ///< Crane position of the stack slot
+}RecipeContext;
+
+/// \brief      Fixed list of steps
+template <std::size_t Size>
+using StepRecipe = std::array<RecipeStep, Size>;
+
+/// \brief      Get the parameter of a recipe step
+/// \pre        None
+/// \post       Nothing
+/// \param[in]  step Recipe step
+/// \param[in]  context Values of the command
+/// \returns    Step parameter, 0 for steps without one
+constexpr int ResolveRecipeStep(const RecipeStep& step, const RecipeContext& context){
+    switch(step.argument){
+        case RecipeArgument::VALUE: return step.value;
+        case RecipeArgument::HOME: return context.home;
+        case RecipeArgument::INTAKE: return context.intake;
+        case RecipeArgument::DRAWER: return context.drawer;
+        case RecipeArgument::DRAWER_POSITION: return context.drawerPosition;
+        case RecipeArgument::SLOT_POSITION: return context.slotPosition;
+        case RecipeArgument::NONE: return 0;
+    }
+    return 0;
+}
+
+/// \brief      Check that the magnet is off after a recipe
+/// \pre        None
+/// \post       Nothing
+/// \param[in]  recipe Recipe to check
+/// \returns    True if the last magnet step switches it off or the recipe has no magnet steps
+template <std::size_t Size>
+constexpr bool RecipeEndsMagnetOff(const StepRecipe<Size>& recipe){
+    bool on = false;
+    for(std::size_t i = 0; i < Size; i++){
+        if(recipe[i].type == StepType::MAGNET) on = recipe[i].argument != RecipeArgument::VALUE || recipe[i].value != 0;
+    }
+    return !on;
+}
+
+/// \brief      Check that the crane is home after a recipe
+/// \pre        None
+/// \post       Nothing
+/// \param[in]  recipe Recipe to check
+/// \returns    True if the last crane move goes home or the recipe does not move the crane
+template <std::size_t Size>
+constexpr bool RecipeEndsHome(const StepRecipe<Size>& recipe){
+    bool home = true;
+    for(std::size_t i = 0; i < Size; i++){
+        if(recipe[i].type == StepType::CRANE_MOVE) home = recipe[i].argument == RecipeArgument::HOME;
+    }
+    return home;
+}
+
+/// \brief      Check that drawers are only extended with the crane home
+/// \pre        None
+/// \post       Nothing
+/// \param[in]  recipe Recipe to check
+/// \param[in]  startsHome True if the crane is home when the recipe starts
+/// \returns    True if every drawer extend follows a crane move home
+template <std::size_t Size>
+constexpr bool RecipeExtendsAtHome(const StepRecipe<Size>& recipe, bool startsHome){
+    bool home = startsHome;
+    for(std::size_t i = 0; i < Size; i++){
+        if(recipe[i].type == StepType::CRANE_MOVE) home = recipe[i].argument == RecipeArgument::HOME;
+        if(recipe[i].type == StepType::DRAWER_EXTEND && !home) return false;
+    }
+    return true;
+}
+
+/// \brief      Recipes of the cabinet commands
+/// \details    Place and remove of a combination are a prologue, one filter recipe per filter
+///             and for place an epilogue. Return messages are queued by Logic after the recipe.
+namespace Recipes
+{
+    /// \brief      ADDFILTER, carry the filter from the intake drawer to its drawer
+    inline constexpr StepRecipe<10> AddFilter = {{
+        {StepType::CRANE_MOVE, RecipeArgument::HOME, 0},
+        {StepType::ALL_DRAWERS_RETRACT, RecipeArgument::NONE, 0},
+        {StepType::CRANE_MOVE, RecipeArgument::INTAKE, 0},
+        {StepType::MAGNET, RecipeArgument::VALUE, 1},
+        {StepType::CRANE_MOVE, RecipeArgument::HOME, 0},
+        {StepType::DRAWER_EXTEND, RecipeArgument::DRAWER, 0},
+        {StepType::CRANE_MOVE, RecipeArgument::DRAWER_POSITION, 0},
+        {StepType::MAGNET, RecipeArgument::VALUE, 0},
+        {StepType::CRANE_MOVE, RecipeArgument::HOME, 0},
+        {StepType::ALL_DRAWERS_RETRACT, RecipeArgument::NONE, 0}
+    }};
+
+    /// \brief      REQUESTADDFILTER, open the intake drawer
+    inline constexpr StepRecipe<2> RequestAddFilter = {{
+        {StepType::CRANE_MOVE, RecipeArgument::HOME, 0},
+        {StepType::DRAWER_EXTEND, RecipeArgument::VALUE, 0}
+    }};
+
+    /// \brief      CANCELADDFILTER, close the intake drawer
+    inline constexpr StepRecipe<1> CancelAddFilter = {{
+        {StepType::ALL_DRAWERS_RETRACT, RecipeArgument::NONE, 0}
+    }};
+
+    /// \brief      REMOVEFILTER and CANCELREMOVEFILTER, park the crane and close the drawers
+    inline constexpr StepRecipe<2> Park = {{
+        {StepType::CRANE_MOVE, RecipeArgument::HOME, 0},
+        {StepType::ALL_DRAWERS_RETRACT, RecipeArgument::NONE, 0}
+    }};
+
+    /// \brief      REQUESTREMOVEFILTER, carry the filter from its drawer to the intake drawer
+    inline constexpr StepRecipe<10> RequestRemoveFilter = {{
+        {StepType::CRANE_MOVE, RecipeArgument::HOME, 0},
+        {StepType::ALL_DRAWERS_RETRACT, RecipeArgument::NONE, 0},
+        {StepType::DRAWER_EXTEND, RecipeArgument::DRAWER, 0},
+        {StepType::CRANE_MOVE, RecipeArgument::DRAWER_POSITION, 0},
+        {StepType::MAGNET, RecipeArgument::VALUE, 1},
+        {StepType::ALL_DRAWERS_RETRACT, RecipeArgument::NONE, 0},
+        {StepType::CRANE_MOVE, RecipeArgument::INTAKE, 0},
+        {StepType::MAGNET, RecipeArgument::VALUE, 0},
+        {StepType::CRANE_MOVE, RecipeArgument::HOME, 0},
+        {StepType::DRAWER_EXTEND, RecipeArgument::VALUE, 0}
+    }};
+
+    /// \brief      Start of PLACECOMBINATION and REMOVECOMBINATION
+    inline constexpr StepRecipe<2> CombinationPrologue = {{
+        {StepType::ALL_DRAWERS_RETRACT, RecipeArgument::NONE, 0},
+        {StepType::CRANE_MOVE, RecipeArgument::HOME, 0}
+    }};
+
+    /// \brief      PLACECOMBINATION, carry one filter from its drawer to its stack slot
+    /// \details    Drawers only extend with the crane home, retracting is done with the filter lifted
+    inline constexpr StepRecipe<7> PlaceFilter = {{
+        {StepType::DRAWER_EXTEND, RecipeArgument::DRAWER, 0},
+        {StepType::CRANE_MOVE, RecipeArgument::DRAWER_POSITION, 0},
+        {StepType::MAGNET, RecipeArgument::VALUE, 1},
+        {StepType::ALL_DRAWERS_RETRACT, RecipeArgument::NONE, 0},
+        {StepType::CRANE_MOVE, RecipeArgument::SLOT_POSITION, 0},
+        {StepType::MAGNET, RecipeArgument::VALUE, 0},
+        {StepType::CRANE_MOVE, RecipeArgument::HOME, 0}
+    }};
+
+    /// \brief      End of PLACECOMBINATION, open the intake drawer
+    inline constexpr StepRecipe<1> PlaceEpilogue = {{
+        {StepType::DRAWER_EXTEND, RecipeArgument::VALUE, 0}
+    }};
+
+    /// \brief      REMOVECOMBINATION, carry one filter from its stack slot back to its drawer
+    inline constexpr StepRecipe<8> RemoveFilter = {{
+        {StepType::CRANE_MOVE, RecipeArgument::SLOT_POSITION, 0},
+        {StepType::MAGNET, RecipeArgument::VALUE, 1},
+        {StepType::CRANE_MOVE, RecipeArgument::HOME, 0},
+        {StepType::DRAWER_EXTEND, RecipeArgument::DRAWER, 0},
+        {StepType::CRANE_MOVE, RecipeArgument::DRAWER_POSITION, 0},
+        {StepType::MAGNET, RecipeArgument::VALUE, 0},
+        {StepType::CRANE_MOVE, RecipeArgument::HOME, 0},
+        {StepType::ALL_DRAWERS_RETRACT, RecipeArgument::NONE, 0}
+    }};
+
+    static_assert(RecipeEndsMagnetOff(AddFilter) && RecipeEndsHome(AddFilter) && RecipeExtendsAtHome(AddFilter, false), "AddFilter recipe is not safe");
+    static_assert(RecipeEndsHome(RequestAddFilter) && RecipeExtendsAtHome(RequestAddFilter, false), "RequestAddFilter recipe is not safe");
+    static_assert(RecipeEndsMagnetOff(RequestRemoveFilter) && RecipeEndsHome(RequestRemoveFilter) && RecipeExtendsAtHome(RequestRemoveFilter, false), "RequestRemoveFilter recipe is not safe");
+    static_assert(RecipeEndsHome(CombinationPrologue) && RecipeEndsHome(Park), "Prologue recipes do not park the crane");
+    // Every filter recipe starts where the prologue or the previous filter recipe ended
+    static_assert(RecipeEndsMagnetOff(PlaceFilter) && RecipeEndsHome(PlaceFilter) && RecipeExtendsAtHome(PlaceFilter, true), "PlaceFilter recipe is not safe");
+    static_assert(RecipeExtendsAtHome(PlaceEpilogue, true), "PlaceEpilogue recipe is not safe");
+    static_assert(RecipeEndsMagnetOff(RemoveFilter) && RecipeEndsHome(RemoveFilter) && RecipeExtendsAtHome(RemoveFilter, false), "RemoveFilter recipe is not safe");
+}
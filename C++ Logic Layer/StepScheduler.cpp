@@ -0,0 +1,207 @@
+/// \file       StepScheduler.cpp
+
+#include "StepScheduler.hpp"
+
+#include <cstddef>
+
+/// \brief      Microseconds between two time points, 0 if to is not later
+static uint64_t ElapsedUs(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to){
+    if(to <= from) return 0;
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(to - from).count();
+}
+
+StepScheduler::StepScheduler(int homePosition){
+    this->homePosition = homePosition;
+    open = -1;
+    running = -1;
+    sequence = 0;
+}
+
+bool StepScheduler::Begin(int priority, TaskCommandEnum command, std::chrono::steady_clock::time_point received){
+    if(open >= 0) End();
+    for(int i = 0; i < STEP_GROUP_COUNT; i++){
+        if(groups[i].used) continue;
+        groups[i].used = true;
+        groups[i].open = true;
+        groups[i].started = false;
+        groups[i].failed = false;
+        groups[i].restoreSteps = 0;
+        groups[i].priority = priority;
+        groups[i].sequence = sequence++;
+        groups[i].command = command;
+        groups[i].subject.clear();
+        groups[i].received = received;
+        open = i;
+        return true;
+    }
+    return false;
+}
+
+bool StepScheduler::End(void){
+    if(open < 0) return false;
+    bool kept = !groups[open].steps.Empty();
+    groups[open].open = false;
+    if(!kept) Release(open);
+    open = -1;
+    return kept;
+}
+
+bool StepScheduler::Push(const Step& step){
+    if(open < 0) return false;
+    return groups[open].steps.Push(step);
+}
+
+Task* StepScheduler::PushResponse(Task&& response){
+    if(open < 0) return NULL;
+    PendingResponse pending;
+    pending.task = std::move(response);
+    pending.queued = std::chrono::steady_clock::now();
+    if(!groups[open].responses.Push(std::move(pending))) return NULL;
+    return &*groups[open].responses.Back().task;
+}
+
+void StepScheduler::SetSubject(const std::string& subject){
+    if(open >= 0) groups[open].subject = subject;
+}
+
+Step& StepScheduler::Back(void){
+    return groups[open].steps.Back();
+}
+
+bool StepScheduler::OpenEmpty(void){
+    return open < 0 || groups[open].steps.Empty();
+}
+
+Step* StepScheduler::Next(bool safe){
+    int best = Best();
+    bool switchGroup = running < 0 ||
+        (safe && best >= 0 && best != running && groups[best].priority > groups[running].priority);
+    if(switchGroup){
+        if(best < 0) return NULL;
+        running = best;
+        if(groups[running].started && !Restore(groups[running])){
+            // The group can not continue from an unknown cabinet state, CancelFailed removes it
+            groups[running].failed = true;
+            running = -1;
+            return NULL;
+        }
+    }
+    return &groups[running].steps.Front();
+}
+
+void StepScheduler::Pop(StepCompletion* completion){
+    if(running < 0) return;
+    StepGroup& group = groups[running];
+    bool responseSent = group.steps.Front().GetType() == StepType::SEND_RETURN_MESSAGE && !group.responses.Empty();
+    group.steps.Pop();
+    if(group.restoreSteps > 0) group.restoreSteps--;
+    // Only read the clock when a time is recorded, most steps are neither the first, the last nor a message
+    std::chrono::steady_clock::time_point now;
+    if(responseSent || !group.started || group.steps.Empty()) now = std::chrono::steady_clock::now();
+    if(responseSent){
+        completion->responseSent = true;
+        completion->responseLatencyUs = ElapsedUs(group.responses.Front().queued, now);
+        group.responses.Pop();
+    }
+    if(!group.started) group.dispatched = now;
+    group.started = true;
+    if(group.steps.Empty()){
+        completion->taskDone = true;
+        completion->command = group.command;
+        completion->queueUs = ElapsedUs(group.received, group.dispatched);
+        completion->totalUs = ElapsedUs(group.received, now);
+        Release(running);
+        running = -1;
+    }
+}
+
+bool StepScheduler::CancelRunning(CancelledTask* cancelled){
+    if(running < 0) return false;
+    Cancel(running, cancelled);
+    running = -1;
+    return true;
+}
+
+bool StepScheduler::CancelInterrupted(CancelledTask* cancelled){
+    for(int i = 0; i < STEP_GROUP_COUNT; i++){
+        if(i == running || !groups[i].used || groups[i].open || !groups[i].started) continue;
+        Cancel(i, cancelled);
+        return true;
+    }
+    return false;
+}
+
+bool StepScheduler::CancelFailed(CancelledTask* cancelled){
+    for(int i = 0; i < STEP_GROUP_COUNT; i++){
+        if(!groups[i].used || !groups[i].failed) continue;
+        Cancel(i, cancelled);
+        return true;
+    }
+    return false;
+}
+
+bool StepScheduler::Empty(void){
+    return Best() < 0;
+}
+
+int StepScheduler::FreeGroups(void){
+    int count = 0;
+    for(int i = 0; i < STEP_GROUP_COUNT; i++){
+        if(!groups[i].used) count++;
+    }
+    return count;
+}
+
+int StepScheduler::StepCount(void){
+    int count = 0;
+    for(int i = 0; i < STEP_GROUP_COUNT; i++){
+        if(groups[i].used) count += groups[i].steps.Size();
+    }
+    return count;
+}
+
+int StepScheduler::Best(void){
+    int best = -1;
+    for(int i = 0; i < STEP_GROUP_COUNT; i++){
+        const StepGroup& group = groups[i];
+        if(!group.used || group.open || group.failed || group.steps.Empty()) continue;
+        if(best < 0 || group.priority > groups[best].priority ||
+           (group.priority == groups[best].priority && group.sequence < groups[best].sequence)){
+            best = i;
+        }
+    }
+    return best;
+}
+
+bool StepScheduler::Restore(StepGroup& group){
+    // Another group ran in between, bring the cabinet back to the state this group left it in.
+    // Restore steps of an earlier interruption that did not run yet are replaced.
+    for(; group.restoreSteps > 0; group.restoreSteps--) group.steps.Pop();
+    if(!group.steps.PushFront(Step(StepType::CRANE_MOVE, homePosition))) return false;
+    group.restoreSteps = 1;
+    if(!group.steps.PushFront(Step(StepType::ALL_DRAWERS_RETRACT))) return false;
+    group.restoreSteps = 2;
+    return true;
+}
+
+void StepScheduler::Cancel(int group, CancelledTask* cancelled){
+    cancelled->command = groups[group].command;
+    cancelled->subject = groups[group].subject;
+    cancelled->started = groups[group].started;
+    cancelled->responses.clear();
+    while(!groups[group].responses.Empty()){
+        if(groups[group].responses.Front().task) cancelled->responses.push_back(std::move(*groups[group].responses.Front().task));
+        groups[group].responses.Pop();
+    }
+    Release(group);
+}
+
+void StepScheduler::Release(int group){
+    groups[group].used = false;
+    groups[group].open = false;
+    groups[group].started = false;
+    groups[group].failed = false;
+    groups[group].restoreSteps = 0;
+    groups[group].steps.Clear();
+    groups[group].responses.Clear();
+}
@@ -0,0 +1,197 @@
+/// \file       StepScheduler.hpp
+/// \brief      Header file for the step scheduler
+///             StepScheduler keeps the steps of every task in its own group and runs groups by task
+///             priority. A running group is only interrupted at a safe point between two steps.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "RingBuffer.hpp"
+#include "Step.hpp"
+#include "Task.h"
+
+/// \brief      Number of task step groups that can be queued at the same time
+#define STEP_GROUP_COUNT 8
+/// \brief      Maximum number of steps in one group
+#define STEP_GROUP_CAPACITY 64
+/// \brief      Maximum number of return messages in one group
+#define STEP_GROUP_RESPONSES 2
+
+/// \brief      Return message waiting for its SEND_RETURN_MESSAGE step
+typedef struct {
+    std::optional<Task> task;                           ///< Message to send
+    std::chrono::steady_clock::time_point queued;       ///< Time the message was queued
+}PendingResponse;
+
+/// \brief      Steps of one task
+typedef struct {
+    bool used = false;                                  ///< False if the group is free
+    bool open = false;                                  ///< True while steps are being added
+    bool started = false;                               ///< True once a step has been executed
+    bool failed = false;                                ///< True if the group can not continue, see CancelFailed
+    int restoreSteps = 0;                               ///< Restore steps at the front that did not run yet
+    int priority = 0;                                   ///< Task priority, higher runs first
+    uint64_t sequence = 0;                              ///< Order of creation, lower runs first on equal priority
+    TaskCommandEnum command;                            ///< Command of the task
+    std::string subject;                                ///< Filter or combination the task changed, empty if none
+    std::chrono::steady_clock::time_point received;     ///< Time the task was received
+    std::chrono::steady_clock::time_point dispatched;   ///< Time the first step ran
+    RingBuffer<Step, STEP_GROUP_CAPACITY> steps;        ///< Steps not yet executed
+    RingBuffer<PendingResponse, STEP_GROUP_RESPONSES> responses;    ///< Messages of the SEND_RETURN_MESSAGE steps
+}StepGroup;
+
+/// \brief      What finished with a step removed by Pop()
+typedef struct {
+    bool responseSent = false;                          ///< True if the step sent a return message
+    uint64_t responseLatencyUs = 0;                     ///< Time between storing and sending the message
+    bool taskDone = false;                              ///< True if the step was the last of its task
+    TaskCommandEnum command;                            ///< Command of the task, if taskDone
+    uint64_t queueUs = 0;                               ///< Time from receiving the task until its first step ran
+    uint64_t totalUs = 0;                               ///< Time from receiving the task until its last step ran
+}StepCompletion;
+
+/// \brief      Group removed before all its steps ran
+typedef struct {
+    TaskCommandEnum command;                            ///< Command of the task
+    std::string subject;                                ///< Filter or combination the task changed
+    bool started = false;                               ///< True if some of its steps were executed
+    std::vector<Task> responses;                        ///< Return messages that were not sent
+}CancelledTask;
+
+/// \brief      Priority scheduler for task step groups
+/// \details    Steps are added to the open group between Begin() and End(). Next() returns the
+///             front step of the running group. When the caller reports a safe point, a group with
+///             a higher priority takes over; the interrupted group continues once no group with a
+///             higher priority is left. Before an interrupted group continues, a retract of all
+///             drawers and a crane move home are run first to restore the state it was left in.
+///             Restore steps that did not run yet are replaced, so a group interrupted again
+///             before its restore steps ran still gets them once.
+class StepScheduler
+{
+public:
+    /// \brief      Constructor
+    /// \pre        None
+    /// \post       Scheduler without groups
+    /// \param[in]  homePosition Crane position an interrupted group is resumed from
+    /// \returns    Nothing
+    StepScheduler(int homePosition);
+
+    /// \brief      Open a new group
+    /// \pre        No group open
+    /// \post       Steps are added to the new group until End()
+    /// \param[in]  priority Priority of the task, higher runs first
+    /// \param[in]  command Command of the task
+    /// \param[in]  received Time the task was received
+    /// \returns    True on success, false if all groups are in use
+    bool Begin(int priority, TaskCommandEnum command, std::chrono::steady_clock::time_point received);
+
+    /// \brief      Close the open group
+    /// \pre        None
+    /// \post       Group can be scheduled, an empty group is freed
+    /// \returns    True if the group has steps, false if it was freed or no group was open
+    bool End(void);
+
+    /// \brief      Add a step to the open group
+    /// \pre        Group open
+    /// \post       Step added if there was room
+    /// \param[in]  step Step to add
+    /// \returns    True on success, false if there is no open group or it is full
+    bool Push(const Step& step);
+
+    /// \brief      Store a return message in the open group
+    /// \pre        Group open
+    /// \post       Message moved into the group with the current time
+    /// \param[in]  response Message to store
+    /// \returns    Pointer for the SEND_RETURN_MESSAGE step, NULL if there is no room
+    Task* PushResponse(Task&& response);
+
+    /// \brief      Set the filter or combination the open group changes
+    /// \pre        Group open
+    /// \post       Subject stored for CancelledTask
+    /// \param[in]  subject ID of the filter or combination
+    /// \returns    Nothing
+    void SetSubject(const std::string& subject);
+
+    /// \brief      Get the last step added to the open group
+    /// \pre        OpenEmpty() is false
+    /// \post       Nothing
+    /// \returns    Reference to the step
+    Step& Back(void);
+
+    /// \brief      Check if the open group has no steps yet
+    /// \returns    True if there is no open group or it has no steps
+    bool OpenEmpty(void);
+
+    /// \brief      Get the next step to execute
+    /// \pre        None
+    /// \post       Running group selected. A group whose restore steps do not fit is marked failed.
+    /// \param[in]  safe True if the cabinet is at a point where the running group may be interrupted
+    /// \returns    Step to execute, NULL if no steps are queued or a group failed to resume
+    Step* Next(bool safe);
+
+    /// \brief      Remove the step returned by Next()
+    /// \pre        Next() returned a step
+    /// \post       Step removed, the message of a SEND_RETURN_MESSAGE step is released
+    /// \param[out] completion Message latency and task times if the step finished them
+    /// \returns    Nothing
+    void Pop(StepCompletion* completion);
+
+    /// \brief      Remove the running group
+    /// \pre        None
+    /// \post       Group freed, its return messages moved to cancelled
+    /// \param[out] cancelled Task of the removed group
+    /// \returns    True if a group was running
+    bool CancelRunning(CancelledTask* cancelled);
+
+    /// \brief      Remove a group that was interrupted by a group with a higher priority
+    /// \pre        None
+    /// \post       Group freed, its return messages moved to cancelled
+    /// \param[out] cancelled Task of the removed group
+    /// \returns    True if a group was removed, false if no started group is waiting
+    bool CancelInterrupted(CancelledTask* cancelled);
+
+    /// \brief      Remove a group that failed to resume
+    /// \pre        None
+    /// \post       Group freed, its return messages moved to cancelled
+    /// \param[out] cancelled Task of the removed group
+    /// \returns    True if a group was removed, false if no group failed
+    bool CancelFailed(CancelledTask* cancelled);
+
+    /// \brief      Check if steps are queued
+    /// \returns    True if no closed group has steps
+    bool Empty(void);
+
+    /// \brief      Get number of free groups
+    /// \returns    Groups that can still be opened with Begin()
+    int FreeGroups(void);
+
+    /// \brief      Get number of queued steps
+    /// \returns    Steps in all groups
+    int StepCount(void);
+
+private:
+    /// \brief      Group storage
+    StepGroup groups[STEP_GROUP_COUNT];
+    /// \brief      Group being filled, -1 if none
+    int open;
+    /// \brief      Group being executed, -1 if none
+    int running;
+    /// \brief      Sequence number for the next group
+    uint64_t sequence;
+    /// \brief      Crane position an interrupted group is resumed from
+    int homePosition;
+
+    /// \brief      Find the closed group with the highest priority, -1 if none
+    int Best(void);
+    /// \brief      Queue the restore steps in front of an interrupted group, false if they do not fit
+    bool Restore(StepGroup& group);
+    /// \brief      Free a group
+    void Release(int group);
+    /// \brief      Move a group into a CancelledTask and free it
+    void Cancel(int group, CancelledTask* cancelled);
+};
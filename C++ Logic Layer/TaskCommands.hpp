@@ -0,0 +1,24 @@
+/// \file       TaskCommands.hpp
+/// \brief      Header file for the commands the Logic layer adds to the API protocol
+///             TaskCommandEnum is defined in Task.h of the API layer, its value is the command
+///             number sent on the wire. The baseline protocol numbers its commands 0 to 17, from
+///             ADDFILTER to REMOVEFILTERCOMBINATIONCALLBACK. The Logic layer needs these commands
+///             appended to TaskCommandEnum in Task.h with exactly these numbers:
+///                 GETFILTERSBYMATERIAL = 18       parameters: material
+///                 GETFILTERSBYTHICKNESS = 19      parameters: minimum, maximum thickness
+///                 GETFREEDRAWER = 20              no parameters
+///                 GETMETRICS = 21                 no parameters
+///             The checks below stop the build if Task.h does not number them this way.
+
+#pragma once
+
+#include "Task.h"
+
+/// \brief      Number of commands in the protocol
+#define TASK_COMMAND_COUNT 22
+
+static_assert((int)TaskCommandEnum::REMOVEFILTERCOMBINATIONCALLBACK == 17, "Task.h does not number the baseline commands 0 to 17");
+static_assert((int)TaskCommandEnum::GETFILTERSBYMATERIAL == 18, "Task.h must define GETFILTERSBYMATERIAL as command 18");
+static_assert((int)TaskCommandEnum::GETFILTERSBYTHICKNESS == 19, "Task.h must define GETFILTERSBYTHICKNESS as command 19");
+static_assert((int)TaskCommandEnum::GETFREEDRAWER == 20, "Task.h must define GETFREEDRAWER as command 20");
+static_assert((int)TaskCommandEnum::GETMETRICS == 21, "Task.h must define GETMETRICS as command 21");
@@ -0,0 +1,122 @@
+/// \file       DatabaseIndexBenchmark.cpp
+/// \brief      Micro-benchmark of the filter and combination id indexes of Database
+///             Usage: DatabaseIndexBenchmark
+///             Fills a database with 10, 1000 and 100000 filters and as many combinations, then
+///             times GetFilterById and GetFilterCombination against a linear scan over the records,
+///             the lookup Database did before the indexes. Exits with 1 if the two disagree.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Database.hpp"
+
+/// \brief      Number of lookups timed through the index
+#define INDEX_LOOKUPS 1000000
+/// \brief      Number of records visited by the timed scans, bounds the scan time at every size
+#define SCAN_VISITS 50000000ULL
+
+/// \brief      Find a filter by scanning all filters
+static const Filter* ScanFilter(Database& database, const std::string& id){
+    for (const Filter& f : database.GetFilters()) {
+        if (f.id == id) return &f;
+    }
+    return NULL;
+}
+
+/// \brief      Find a combination by scanning all combinations
+static const Combination* ScanCombination(Database& database, const std::string& id){
+    for (const Combination& c : database.GetFilterCombinations()) {
+        if (c.id == id) return &c;
+    }
+    return NULL;
+}
+
+/// \brief      Time a lookup function over a list of ids
+/// \param[in]  ids Ids to look up, cycled through
+/// \param[in]  lookups Number of lookups
+/// \param[in]  lookup Lookup returning NULL if the id is not found
+/// \param[out] misses Number of lookups that found nothing
+/// \returns    Nanoseconds per lookup
+template<typename Lookup>
+static double TimeLookups(const std::vector<std::string>& ids, uint64_t lookups, Lookup lookup, uint64_t* misses){
+    *misses = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < lookups; i++) {
+        if (lookup(ids[i % ids.size()]) == NULL) (*misses)++;
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / lookups;
+}
+
+/// \brief      Benchmark one database size
+/// \param[in]  size Number of filters and combinations
+/// \returns    -1 if the index and the scan disagree, 0 otherwise
+static int Benchmark(int size){
+    Database database(size);
+    std::vector<std::string> filterIds;
+    std::vector<std::string> combinationIds;
+    for (int i = 0; i < size; i++) {
+        Filter f;
+        f.index = i + 1;
+        f.id = "F" + std::to_string(i);
+        f.material = "Steel";
+        f.thickness = "1.0";
+        Combination c;
+        c.id = "C" + std::to_string(i);
+        c.name = "Combination " + std::to_string(i);
+        if (database.AddFilter(f) < 0) return -1;
+        c.filters.push_back(database.GetFilterHandle(f.id));
+        if (database.AddFilterCombination(c) < 0) return -1;
+        filterIds.push_back(f.id);
+        combinationIds.push_back(c.id);
+    }
+    // Visit the ids out of insertion order, half of them unknown
+    std::vector<std::string> filterLookups;
+    std::vector<std::string> combinationLookups;
+    for (int i = 0; i < size; i++) {
+        int j = (int)(((uint64_t)i * 7919) % size);
+        filterLookups.push_back(i % 2 == 0 ? filterIds[j] : "G" + std::to_string(j));
+        combinationLookups.push_back(i % 2 == 0 ? combinationIds[j] : "D" + std::to_string(j));
+    }
+
+    uint64_t scanLookups = SCAN_VISITS / size;
+    if (scanLookups > INDEX_LOOKUPS) scanLookups = INDEX_LOOKUPS;
+    if (scanLookups > filterLookups.size()) scanLookups = filterLookups.size();
+
+    uint64_t misses;
+    double filterIndex = TimeLookups(filterLookups, INDEX_LOOKUPS,
+        [&](const std::string& id) { return (const Filter*)database.GetFilterById(id); }, &misses);
+    double filterScan = TimeLookups(filterLookups, scanLookups,
+        [&](const std::string& id) { return ScanFilter(database, id); }, &misses);
+    double combinationIndex = TimeLookups(combinationLookups, INDEX_LOOKUPS,
+        [&](const std::string& id) { return (const Combination*)database.GetFilterCombination(id); }, &misses);
+    double combinationScan = TimeLookups(combinationLookups, scanLookups,
+        [&](const std::string& id) { return ScanCombination(database, id); }, &misses);
+
+    // The scanned lookups must return the same records through the index
+    bool agree = true;
+    for (uint64_t i = 0; i < scanLookups; i++) {
+        if (database.GetFilterById(filterLookups[i]) != ScanFilter(database, filterLookups[i])) agree = false;
+        if (database.GetFilterCombination(combinationLookups[i]) != ScanCombination(database, combinationLookups[i])) agree = false;
+    }
+
+    std::printf("%-8d %-12s %12.1f %12.1f %10.1fx\n", size, "filter", filterIndex, filterScan, filterScan / filterIndex);
+    std::printf("%-8d %-12s %12.1f %12.1f %10.1fx\n", size, "combination", combinationIndex, combinationScan, combinationScan / combinationIndex);
+    if (!agree) {
+        std::fprintf(stderr, "Index and scan disagree at %d records\n", size);
+        return -1;
+    }
+    return 0;
+}
+
+int main(void){
+    int failed = 0;
+    std::printf("%-8s %-12s %12s %12s %11s\n", "Records", "Lookup", "Index ns", "Scan ns", "Speedup");
+    for (int size : {10, 1000, 100000}) {
+        if (Benchmark(size) < 0) failed = 1;
+    }
+    return failed;
+}
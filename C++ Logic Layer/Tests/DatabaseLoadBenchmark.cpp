@@ -0,0 +1,151 @@
+/// \file       DatabaseLoadBenchmark.cpp
+/// \brief      Benchmark and checks of the database file loaders
+///             Usage: DatabaseLoadBenchmark
+///             Writes a synthetic text database of 1M records, half filters and half combinations,
+///             and times loading it in the text format and after conversion in the binary format.
+///             Then checks that files with invalid records are rejected instead of loaded partly,
+///             and that LoadFromDisk keeps a rejected file. Runs in a new temporary directory.
+///             Exits with 1 if a check fails.
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "Database.hpp"
+
+/// \brief      Number of filter records, the file has as many combination records
+#define LOAD_FILTER_COUNT 500000
+
+/// \brief      Number of failed checks
+static int failures = 0;
+
+/// \brief      Count a failed check
+/// \param[in]  passed Result of the check
+/// \param[in]  what Description of the check
+static void Check(bool passed, const char* what){
+    if (passed) return;
+    std::fprintf(stderr, "Check failed: %s\n", what);
+    failures++;
+}
+
+/// \brief      Write a text database file
+/// \param[in]  path File to write
+/// \param[in]  filters Filter records, without the line end
+/// \param[in]  combinations Combination records, without the line end
+/// \returns    -1 on error, 0 on success
+static int WriteText(const std::string& path, const std::vector<std::string>& filters, const std::vector<std::string>& combinations){
+    std::ofstream file(path, std::ofstream::trunc);
+    if (!file.is_open()) return -1;
+    file << "Filterunit Database File\n\nFilters:\n";
+    for (const std::string& f : filters) file << f << ";\n";
+    file << "End of filters\n\nCombinations:\n";
+    for (const std::string& c : combinations) file << c << ";\n";
+    file << "End of combinations\n\nEnd of file\n";
+    return file.good() ? 0 : -1;
+}
+
+/// \brief      Time loading a database file
+/// \param[in]  path File to load
+/// \param[out] database Database to load into, empty
+/// \param[out] seconds Load time
+/// \returns    Result of ImportFromFile
+static int TimeLoad(const std::string& path, Database& database, double* seconds){
+    auto start = std::chrono::steady_clock::now();
+    int ret = database.ImportFromFile(path);
+    *seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return ret;
+}
+
+/// \brief      Load a large synthetic file in both formats
+static void Benchmark(void){
+    std::vector<std::string> filters;
+    std::vector<std::string> combinations;
+    for (int i = 0; i < LOAD_FILTER_COUNT; i++) {
+        std::string n = std::to_string(i);
+        filters.push_back(std::to_string(i + 1) + ",F" + n + ",Steel," + std::to_string(0.5 + i % 20 * 0.25));
+        // Members spread over the whole file, so resolving them can not rely on locality
+        std::string a = std::to_string((uint64_t)i * 7919 % LOAD_FILTER_COUNT);
+        std::string b = std::to_string(((uint64_t)i * 104729 + 1) % LOAD_FILTER_COUNT);
+        combinations.push_back("C" + n + ",Combination " + n + ",0,2,F" + a + ",F" + b);
+    }
+    Check(WriteText("large.txt", filters, combinations) == 0, "write large text file");
+
+    double textSeconds, binarySeconds;
+    Database text(LOAD_FILTER_COUNT);
+    Check(TimeLoad("large.txt", text, &textSeconds) == 0, "large text file loads");
+    Check(text.GetFilterCount() == LOAD_FILTER_COUNT, "all filters loaded from text");
+    Check(text.GetFilterCombinations().size() == LOAD_FILTER_COUNT, "all combinations loaded from text");
+
+    Check(text.ExportToFile("large.bin", DatabaseFormat::Binary) == 0, "convert to binary");
+    Database binary(LOAD_FILTER_COUNT);
+    Check(TimeLoad("large.bin", binary, &binarySeconds) == 0, "large binary file loads");
+    Check(binary.GetFilterCount() == LOAD_FILTER_COUNT, "all filters loaded from binary");
+    Check(binary.GetFilterCombinations().size() == LOAD_FILTER_COUNT, "all combinations loaded from binary");
+
+    std::printf("Records          %d\n", 2 * LOAD_FILTER_COUNT);
+    std::printf("Text load        %.3f s, %.0f records/s\n", textSeconds, 2 * LOAD_FILTER_COUNT / textSeconds);
+    std::printf("Binary load      %.3f s, %.0f records/s\n", binarySeconds, 2 * LOAD_FILTER_COUNT / binarySeconds);
+    unlink("large.txt");
+    unlink("large.bin");
+}
+
+/// \brief      Check that invalid records reject the file
+static void CheckRejection(void){
+    const std::vector<std::string> filters = {"1,A,Steel,1.0", "2,B,Copper,2.0"};
+
+    Database unknownMember(4);
+    WriteText("unknown.txt", filters, {"K,k,0,2,A,Q"});
+    Check(unknownMember.ImportFromFile("unknown.txt") < 0, "unknown combination member rejects the file");
+    Check(unknownMember.GetFilterCombination("K") == NULL, "combination with an unknown member is not loaded");
+
+    Database memberCount(4);
+    WriteText("count.txt", filters, {"K,k,0,3,A,B"});
+    Check(memberCount.ImportFromFile("count.txt") < 0, "wrong member count rejects the file");
+
+    Database duplicate(4);
+    WriteText("duplicate.txt", {"1,A,Steel,1.0", "2,A,Copper,2.0"}, {});
+    Check(duplicate.ImportFromFile("duplicate.txt") < 0, "duplicate filter id rejects the file");
+
+    Database range(4);
+    WriteText("range.txt", {"1,A,Steel,1.0", "2147483647,B,Copper,2.0"}, {});
+    Check(range.ImportFromFile("range.txt") < 0, "drawer index out of range rejects the file");
+    Check(range.GetFilterById("B") == NULL, "filter out of range is not loaded");
+
+    Database number(4);
+    WriteText("number.txt", {"x,A,Steel,1.0"}, {});
+    Check(number.ImportFromFile("number.txt") < 0, "invalid drawer index rejects the file");
+
+    Database valid(4);
+    WriteText("valid.txt", filters, {"K,k,1,2,B,A"});
+    Check(valid.ImportFromFile("valid.txt") == 0, "valid file loads");
+    Combination* k = valid.GetFilterCombination("K");
+    Check(k != NULL && k->placed && k->filters.size() == 2 &&
+        valid.GetFilter(k->filters.at(0))->id == "B", "combination loaded with its member order");
+
+    // LoadFromDisk reads database.txt and keeps it as database.txt.rejected
+    Database disk(4);
+    WriteText("database.txt", filters, {"K,k,0,2,A,Q"});
+    Check(disk.LoadFromDisk() < 0, "LoadFromDisk rejects the file");
+    Check(access("database.txt.rejected", F_OK) == 0, "rejected file kept");
+
+    for (const char* file : {"unknown.txt", "count.txt", "duplicate.txt", "range.txt", "number.txt",
+        "valid.txt", "database.txt", "database.txt.rejected"}) {
+        unlink(file);
+    }
+}
+
+int main(void){
+    char directory[] = "/tmp/databaseload.XXXXXX";
+    if (mkdtemp(directory) == NULL || chdir(directory) < 0) {
+        std::fprintf(stderr, "Unable to create working directory\n");
+        return 1;
+    }
+    Benchmark();
+    CheckRejection();
+    rmdir(directory);
+    std::printf("Failed checks    %d\n", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,230 @@
+/// \file       DatabaseStressTest.cpp
+/// \brief      Stress test for queries answered from database snapshots while Logic changes the database
+///             Usage: DatabaseStressTest [cycles]
+///             The main thread is the Logic thread: it keeps adding and removing a filter and a
+///             combination that contains it and runs the steps on a SimHal. Reader threads send
+///             GETFILTERS, GETFILTERCOMBINATIONS and GETSYSTEMSTATUS at the same time. Every query
+///             reply must show one consistent database state. Exits with 1 if a reply is inconsistent
+///             or a change fails. Run it built with -fsanitize=thread to check for data races.
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "IQueueHandler.h"
+#include "Logic.hpp"
+#include "SimHal.hpp"
+
+/// \brief      Number of drawers of the simulated cabinet, drawer 0 is the intake
+#define STRESS_DRAWER_COUNT 5
+/// \brief      Highest crane position of the simulated cabinet
+#define STRESS_CRANE_RANGE 140
+/// \brief      Number of threads sending queries
+#define STRESS_READER_COUNT 4
+/// \brief      Default number of add and remove cycles
+#define STRESS_DEFAULT_CYCLES 200
+/// \brief      Most Run() calls to wait for the reply to a change
+#define STRESS_MAX_RUNS 10000
+
+/// \brief      Get all parameters of a message
+/// \param[in]  task Message
+/// \returns    Parameter values
+static std::vector<std::string> GetParameters(Task& task){
+    std::vector<std::string> parameters;
+    for (int i = 0; task.GetParameter(i) != NULL; i++) {
+        std::string value;
+        task.GetParameter(i)->AsString(&value);
+        parameters.push_back(value);
+    }
+    return parameters;
+}
+
+/// \brief      Check a GETFILTERS reply
+/// \details    Filters F1 to F3 are always stored, one filter X<n> may be stored next to them
+/// \returns    Empty string if consistent, otherwise the problem
+static std::string CheckFilters(const std::vector<std::string>& p){
+    if (p.empty() || p.at(0) != "0" || (p.size() - 1) % 3 != 0) return "malformed GETFILTERS reply";
+    int fixed = 0;
+    int extra = 0;
+    for (size_t i = 1; i < p.size(); i += 3) {
+        const std::string& id = p.at(i);
+        if (p.at(i + 1) != "m" + id || p.at(i + 2) != "1.0") return "filter " + id + " has fields of another filter";
+        if (id == "F1" || id == "F2" || id == "F3") fixed++;
+        else if (id.size() > 1 && id[0] == 'X') extra++;
+        else return "unknown filter " + id;
+    }
+    if (fixed != 3 || extra > 1) return "wrong filter count";
+    return "";
+}
+
+/// \brief      Check a GETFILTERCOMBINATIONS reply
+/// \details    Combination S of F1 to F3 is always stored, one combination K<n> of F1 and X<n> may
+///             be stored next to it
+/// \returns    Empty string if consistent, otherwise the problem
+static std::string CheckCombinations(const std::vector<std::string>& p){
+    if (p.empty() || p.at(0) != "0") return "malformed GETFILTERCOMBINATIONS reply";
+    bool fixed = false;
+    int extra = 0;
+    size_t i = 1;
+    while (i < p.size()) {
+        if (i + 4 > p.size()) return "truncated combination";
+        const std::string& id = p.at(i);
+        int count = std::atoi(p.at(i + 3).c_str());
+        if (count < 0 || i + 4 + count > p.size()) return "combination " + id + " has a wrong member count";
+        std::vector<std::string> members(p.begin() + i + 4, p.begin() + i + 4 + count);
+        if (id == "S") {
+            if (members != std::vector<std::string>{"F1", "F2", "F3"}) return "combination S has wrong members";
+            fixed = true;
+        }
+        else if (id.size() > 1 && id[0] == 'K') {
+            std::string n = id.substr(1);
+            if (p.at(i + 1) != "N" + n) return "combination " + id + " has the name of another combination";
+            if (members != std::vector<std::string>{"F1", "X" + n}) return "combination " + id + " has wrong members";
+            extra++;
+        }
+        else return "unknown combination " + id;
+        i += 4 + count;
+    }
+    if (!fixed || extra > 1) return "wrong combination count";
+    return "";
+}
+
+/// \brief      Check a GETSYSTEMSTATUS reply
+/// \details    The cabinet has 4 drawers, so 0 or 1 are free
+/// \returns    Empty string if consistent, otherwise the problem
+static std::string CheckStatus(const std::vector<std::string>& p){
+    if (p.size() != 4 || p.at(0) != "0") return "malformed GETSYSTEMSTATUS reply";
+    if (p.at(3) != "0" && p.at(3) != "1") return "free drawers " + p.at(3);
+    return "";
+}
+
+/// \brief      Queue handler that checks query replies and hands the other replies to the writer
+/// \details    AddTask is called on the thread of the reader for queries and on the Logic thread for
+///             replies of changes, so only the query counters are shared.
+class StressQueueHandler : public IQueueHandler
+{
+public:
+    void AddTask(Task task) override {
+        std::string problem;
+        switch (task.GetCommand()){
+            case TaskCommandEnum::GETFILTERS:
+                problem = CheckFilters(GetParameters(task));
+                break;
+            case TaskCommandEnum::GETFILTERCOMBINATIONS:
+                problem = CheckCombinations(GetParameters(task));
+                break;
+            case TaskCommandEnum::GETSYSTEMSTATUS:
+                problem = CheckStatus(GetParameters(task));
+                break;
+            default:
+            {
+                std::vector<std::string> parameters = GetParameters(task);
+                replies[task.GetMessageID()] = parameters.empty() ? "" : parameters.at(0);
+                return;
+            }
+        }
+        queries++;
+        if (!problem.empty()) {
+            if (failures++ == 0) std::fprintf(stderr, "Inconsistent reply: %s\n", problem.c_str());
+        }
+    }
+
+    /// \brief      Number of checked query replies
+    std::atomic<uint64_t> queries{0};
+    /// \brief      Number of inconsistent query replies
+    std::atomic<uint64_t> failures{0};
+    /// \brief      Result code per message ID of a change, only used on the Logic thread
+    std::map<int, std::string> replies;
+};
+
+/// \brief      Sends changes to Logic one at a time and runs their steps, used on the Logic thread
+class Writer
+{
+public:
+    Writer(Logic& logic, StressQueueHandler& queueHandler) : logic(logic), queueHandler(queueHandler) {}
+
+    /// \brief      Send a change and run steps until it is answered
+    /// \param[in]  command Command of the change
+    /// \param[in]  parameters Parameters of the change
+    /// \returns    True if the change succeeded
+    bool Send(TaskCommandEnum command, const std::vector<std::string>& parameters){
+        Task task(++messageID, 0, 0, command, TaskTypeEnum::REQUESTMESSAGE);
+        for (const std::string& parameter : parameters) task.AddParameter(parameter);
+        logic.callback(std::move(task));
+        for (int runs = 0; queueHandler.replies.count(messageID) == 0 && runs < STRESS_MAX_RUNS; runs++) {
+            logic.Run();
+        }
+        auto reply = queueHandler.replies.find(messageID);
+        std::string result = reply == queueHandler.replies.end() ? "no reply" : reply->second;
+        if (result != "0") {
+            std::fprintf(stderr, "Change %d failed with result \"%s\"\n", (int)command, result.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    Logic& logic;
+    StressQueueHandler& queueHandler;
+    int messageID = 0;
+};
+
+int main(int argc, char** argv){
+    int cycles = argc > 1 ? std::atoi(argv[1]) : STRESS_DEFAULT_CYCLES;
+
+    // Logic keeps its database in the working directory
+    char directory[] = "/tmp/databasestress.XXXXXX";
+    if (mkdtemp(directory) == NULL || chdir(directory) < 0) {
+        std::fprintf(stderr, "Unable to create working directory\n");
+        return 1;
+    }
+
+    SimHal sim(STRESS_DRAWER_COUNT, STRESS_CRANE_RANGE);
+    StressQueueHandler queueHandler;
+    bool passed;
+    {
+        Logic logic(&queueHandler, &sim);
+        FastLog::SetLevel(FASTLOG_LEVEL_WARNING);
+        Writer writer(logic, queueHandler);
+        passed = writer.Send(TaskCommandEnum::ADDFILTER, {"F1", "mF1", "1.0"}) &&
+            writer.Send(TaskCommandEnum::ADDFILTER, {"F2", "mF2", "1.0"}) &&
+            writer.Send(TaskCommandEnum::ADDFILTER, {"F3", "mF3", "1.0"}) &&
+            writer.Send(TaskCommandEnum::ADDFILTERCOMBINATION, {"S", "NS", "3", "F1", "F2", "F3"});
+
+        std::atomic<bool> done{false};
+        std::vector<std::thread> readers;
+        for (int r = 0; passed && r < STRESS_READER_COUNT; r++) {
+            readers.emplace_back([&logic, &done, r](void) {
+                static const TaskCommandEnum queries[] = {TaskCommandEnum::GETFILTERS,
+                    TaskCommandEnum::GETFILTERCOMBINATIONS, TaskCommandEnum::GETSYSTEMSTATUS};
+                for (int i = r; !done; i++) {
+                    logic.callback(Task(-1, 0, 0, queries[i % 3], TaskTypeEnum::REQUESTMESSAGE));
+                }
+            });
+        }
+        // Removing X<n> also removes the combination K<n> that contains it
+        for (int i = 0; passed && i < cycles; i++) {
+            std::string n = std::to_string(i);
+            passed = writer.Send(TaskCommandEnum::ADDFILTER, {"X" + n, "mX" + n, "1.0"}) &&
+                writer.Send(TaskCommandEnum::ADDFILTERCOMBINATION, {"K" + n, "N" + n, "2", "F1", "X" + n}) &&
+                writer.Send(TaskCommandEnum::REMOVEFILTER, {"X" + n});
+        }
+        done = true;
+        for (std::thread& reader : readers) reader.join();
+    }
+
+    std::printf("Cycles           %d\n", cycles);
+    std::printf("Queries          %llu\n", (unsigned long long)queueHandler.queries.load());
+    std::printf("Inconsistent     %llu\n", (unsigned long long)queueHandler.failures.load());
+
+    unlink("database.txt");
+    unlink("database.txt.tmp");
+    unlink("database.journal");
+    rmdir(directory);
+    return passed && queueHandler.failures == 0 && queueHandler.queries > 0 ? 0 : 1;
+}
@@ -0,0 +1,152 @@
+/// \file       ResponseAllocationTest.cpp
+/// \brief      Checks that Logic does not copy requests or return messages
+///             Usage: ResponseAllocationTest
+///             Counts operator new while Logic answers tasks on a SimHal, for a direct answer, a
+///             return message queued until its steps ran and the cached query answers. A task may
+///             allocate no more than building its request and its return message once and reading
+///             every request parameter once does, so every copy shows up as extra allocations.
+///             Logging is turned off during the count. Exits with 1 if a task allocates more.
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "IQueueHandler.h"
+#include "Logic.hpp"
+#include "SimHal.hpp"
+
+/// \brief      Number of times every task is sent while counting
+#define ALLOCATION_ROUNDS 1000
+
+/// \brief      Number of calls to operator new
+static std::atomic<uint64_t> allocations{0};
+
+void* operator new(std::size_t size){
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = std::malloc(size == 0 ? 1 : size);
+    if (p == NULL) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept{
+    std::free(p);
+}
+
+/// \brief      Queue handler that counts and drops return messages
+class CountingQueueHandler : public IQueueHandler
+{
+public:
+    void AddTask(Task) override {
+        messages++;
+    }
+
+    /// \brief      Number of messages received
+    uint64_t messages = 0;
+};
+
+/// \brief      Build a message
+static Task BuildTask(TaskCommandEnum command, const std::vector<std::string>& parameters){
+    Task task(1, 0, 0, command, TaskTypeEnum::REQUESTMESSAGE);
+    for (const std::string& parameter : parameters) task.AddParameter(parameter);
+    return task;
+}
+
+/// \brief      Allocations of building a request and its return message once and reading the request
+/// \details    MessageParameter::AsString copies the parameter, Logic reads every parameter once
+static uint64_t ReferenceAllocations(TaskCommandEnum command, const std::vector<std::string>& request, const std::vector<std::string>& response){
+    // The parameter strings are copied before counting, only the messages are measured
+    std::vector<std::string> requestCopy = request;
+    std::vector<std::string> responseCopy = response;
+    uint64_t before = allocations;
+    for (int i = 0; i < ALLOCATION_ROUNDS; i++) {
+        Task built = BuildTask(command, requestCopy);
+        Task answer = BuildTask(command, responseCopy);
+        for (int j = 0; j < (int)requestCopy.size(); j++) {
+            std::string value;
+            built.GetParameter(j)->AsString(&value);
+        }
+    }
+    return (allocations - before + ALLOCATION_ROUNDS - 1) / ALLOCATION_ROUNDS;
+}
+
+/// \brief      Send a task repeatedly and check its allocations
+/// \param[in]  logic Logic answering the task
+/// \param[in]  sim HAL of logic, run until idle after every task
+/// \param[in]  queueHandler Queue handler of logic
+/// \param[in]  name Name printed for the task
+/// \param[in]  command Command of the task
+/// \param[in]  request Parameters of the task
+/// \param[in]  response Parameters of its return message
+/// \returns    True if the task allocated no more than the reference
+static bool CheckTask(Logic& logic, SimHal& sim, CountingQueueHandler& queueHandler, const char* name,
+    TaskCommandEnum command, const std::vector<std::string>& request, const std::vector<std::string>& response){
+    uint64_t reference = ReferenceAllocations(command, request, response);
+    std::vector<std::string> requestCopy = request;
+    // Warm up the query cache and the step queue
+    logic.callback(BuildTask(command, requestCopy));
+    do logic.Run(); while (sim.getStatus() == HalStatus::BUSY);
+
+    uint64_t messages = queueHandler.messages;
+    uint64_t before = allocations;
+    for (int i = 0; i < ALLOCATION_ROUNDS; i++) {
+        logic.callback(BuildTask(command, requestCopy));
+        do logic.Run(); while (sim.getStatus() == HalStatus::BUSY);
+    }
+    uint64_t used = allocations - before;
+    bool answered = queueHandler.messages - messages == ALLOCATION_ROUNDS;
+    bool passed = answered && used <= reference * ALLOCATION_ROUNDS;
+    std::printf("%-28s %12.2f %12llu %s\n", name, (double)used / ALLOCATION_ROUNDS,
+        (unsigned long long)reference, passed ? "ok" : answered ? "FAILED" : "FAILED, not answered");
+    return passed;
+}
+
+int main(void){
+    char directory[] = "/tmp/responseallocation.XXXXXX";
+    if (mkdtemp(directory) == NULL || chdir(directory) < 0) {
+        std::fprintf(stderr, "Unable to create working directory\n");
+        return 1;
+    }
+
+    // Strings longer than the small string buffer, so every copy allocates
+    const std::string material = "Stainless steel grade 316L, polished";
+    const std::string thickness = "0.125000000000000000000000";
+    const std::vector<std::string> ids = {"Filter with a long identifier A", "Filter with a long identifier B"};
+
+    SimHal sim(5, 140);
+    CountingQueueHandler queueHandler;
+    bool passed = true;
+    {
+        Logic logic(&queueHandler, &sim);
+        for (const std::string& id : ids) {
+            logic.callback(BuildTask(TaskCommandEnum::ADDFILTER, {id, material, thickness}));
+            do logic.Run(); while (sim.getStatus() == HalStatus::BUSY);
+        }
+        logic.callback(BuildTask(TaskCommandEnum::ADDFILTERCOMBINATION, {"Combination", "Name", "2", ids[0], ids[1]}));
+        FastLog::SetLevel(FASTLOG_LEVEL_OFF);
+
+        std::printf("%-28s %12s %12s\n", "Task", "Allocs/task", "Reference");
+        passed &= CheckTask(logic, sim, queueHandler, "GETFREEDRAWER", TaskCommandEnum::GETFREEDRAWER,
+            {}, {"0", "3"});
+        passed &= CheckTask(logic, sim, queueHandler, "REQUESTADDFILTER", TaskCommandEnum::REQUESTADDFILTER,
+            {"New filter with a long identifier"}, {"0"});
+        passed &= CheckTask(logic, sim, queueHandler, "GETFILTERS", TaskCommandEnum::GETFILTERS,
+            {}, {"0", ids[0], material, thickness, ids[1], material, thickness});
+        passed &= CheckTask(logic, sim, queueHandler, "GETFILTERCOMBINATIONS", TaskCommandEnum::GETFILTERCOMBINATIONS,
+            {}, {"0", "Combination", "Name", "false", "2", ids[0], ids[1]});
+        FastLog::SetLevel(FASTLOG_LEVEL_WARNING);
+    }
+
+    unlink("database.txt");
+    unlink("database.txt.tmp");
+    unlink("database.journal");
+    rmdir(directory);
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,159 @@
+/// \file       StepQueueBenchmark.cpp
+/// \brief      Benchmark of the step queue, counts heap allocations per step
+///             Usage: StepQueueBenchmark
+///             Times queueing and running steps three ways: a std::queue of heap steps as Logic used
+///             before, the StepScheduler on its own, and Logic running CANCELADDFILTER tasks on a
+///             SimHal. Operator new is counted to show the allocations per step. Exits with 1 if the
+///             StepScheduler allocates after the warm up round.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <queue>
+#include <unistd.h>
+
+#include "IQueueHandler.h"
+#include "Logic.hpp"
+#include "SimHal.hpp"
+#include "StepScheduler.hpp"
+
+/// \brief      Number of step groups queued and run per measurement
+#define BENCHMARK_GROUPS 200000
+/// \brief      Number of steps per group, the length of an ADDFILTER sequence
+#define BENCHMARK_GROUP_STEPS 10
+/// \brief      Number of tasks sent to Logic
+#define BENCHMARK_TASKS 20000
+
+/// \brief      Number of calls to operator new
+static std::atomic<uint64_t> allocations{0};
+
+void* operator new(std::size_t size){
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = std::malloc(size == 0 ? 1 : size);
+    if (p == NULL) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept{
+    std::free(p);
+}
+
+/// \brief      Steps and allocations of one measurement
+typedef struct {
+    uint64_t steps = 0;         ///< Number of steps queued and run
+    uint64_t allocations = 0;   ///< Calls to operator new
+    double seconds = 0;         ///< Run time
+}Measurement;
+
+/// \brief      Step of a group, the types follow the ADDFILTER sequence
+static Step GroupStep(int i){
+    static const StepType types[] = {StepType::CRANE_MOVE, StepType::DRAWER_EXTEND, StepType::MAGNET,
+        StepType::CRANE_MOVE, StepType::MAGNET};
+    return Step(types[i % 5], i);
+}
+
+/// \brief      Queue and run steps as heap objects in a std::queue
+static Measurement RunHeapQueue(void){
+    std::queue<Step*> queue;
+    Measurement m;
+    uint64_t before = allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (int g = 0; g < BENCHMARK_GROUPS; g++) {
+        for (int i = 0; i < BENCHMARK_GROUP_STEPS; i++) queue.push(new Step(GroupStep(i)));
+        while (!queue.empty()) {
+            Step* s = queue.front();
+            queue.pop();
+            m.steps += s->GetParam() >= 0;
+            delete s;
+        }
+    }
+    m.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    m.allocations = allocations - before;
+    return m;
+}
+
+/// \brief      Queue and run steps in the StepScheduler
+static Measurement RunScheduler(StepScheduler& scheduler){
+    Measurement m;
+    uint64_t before = allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (int g = 0; g < BENCHMARK_GROUPS; g++) {
+        scheduler.Begin(0, TaskCommandEnum::ADDFILTER, start);
+        for (int i = 0; i < BENCHMARK_GROUP_STEPS; i++) scheduler.Push(GroupStep(i));
+        scheduler.End();
+        Step* s;
+        while ((s = scheduler.Next(true)) != NULL) {
+            m.steps += s->GetParam() >= 0;
+            StepCompletion completion;
+            scheduler.Pop(&completion);
+        }
+    }
+    m.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    m.allocations = allocations - before;
+    return m;
+}
+
+/// \brief      Queue handler that drops all messages
+class NullQueueHandler : public IQueueHandler
+{
+public:
+    void AddTask(Task) override {}
+};
+
+/// \brief      Send tasks to Logic and run their steps on a SimHal
+static Measurement RunLogic(void){
+    NullQueueHandler queueHandler;
+    SimHal sim(5, 140);
+    Logic logic(&queueHandler, &sim);
+    FastLog::SetLevel(FASTLOG_LEVEL_WARNING);
+    Measurement m;
+    uint64_t before = allocations;
+    uint64_t stepsBefore = logic.GetRunStatistics().stepCount;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < BENCHMARK_TASKS; t++) {
+        logic.callback(Task(t, 0, 0, TaskCommandEnum::CANCELADDFILTER, TaskTypeEnum::REQUESTMESSAGE));
+        do logic.Run(); while (sim.getStatus() == HalStatus::BUSY);
+    }
+    m.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    m.allocations = allocations - before;
+    m.steps = logic.GetRunStatistics().stepCount - stepsBefore;
+    return m;
+}
+
+/// \brief      Print a measurement
+static void Print(const char* name, const Measurement& m){
+    std::printf("%-28s %10llu %14.0f %12.3f\n", name, (unsigned long long)m.steps,
+        m.steps / m.seconds, m.steps ? (double)m.allocations / m.steps : 0.0);
+}
+
+int main(void){
+    char directory[] = "/tmp/stepqueue.XXXXXX";
+    if (mkdtemp(directory) == NULL || chdir(directory) < 0) {
+        std::fprintf(stderr, "Unable to create working directory\n");
+        return 1;
+    }
+
+    std::printf("%-28s %10s %14s %12s\n", "Queue", "Steps", "Steps/s", "Allocs/step");
+    Print("std::queue<Step*>", RunHeapQueue());
+    StepScheduler scheduler(0);
+    RunScheduler(scheduler);
+    Measurement steady = RunScheduler(scheduler);
+    Print("StepScheduler", steady);
+    Print("Logic CANCELADDFILTER", RunLogic());
+
+    unlink("database.txt");
+    unlink("database.txt.tmp");
+    unlink("database.journal");
+    rmdir(directory);
+    if (steady.allocations != 0) {
+        std::fprintf(stderr, "StepScheduler allocated %llu times\n", (unsigned long long)steady.allocations);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,204 @@
+/// \file       TraceReplay.cpp
+/// \brief      Benchmark driver that replays a task trace against Logic on a SimHal
+///             Usage: TraceReplay <trace file>
+///             Every trace line is "<arrival in seconds>,<COMMAND>[,parameter...];", lines starting
+///             with # are comments. Tasks are passed to Logic::callback when the simulated clock
+///             reaches their arrival time. The replay runs in a new temporary directory, so it starts
+///             with an empty database. Prints the simulated time, crane travel, tasks/hour and per
+///             command latency percentiles. Latency runs from arrival until the last message Logic
+///             sends with the message ID of the task, on the simulated clock.
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "IQueueHandler.h"
+#include "Logic.hpp"
+#include "Metrics.hpp"
+#include "SimHal.hpp"
+
+/// \brief      Number of drawers of the simulated cabinet, drawer 0 is the intake
+#define REPLAY_DRAWER_COUNT 5
+/// \brief      Highest crane position of the simulated cabinet
+#define REPLAY_CRANE_RANGE 140
+
+/// \brief      Task of the trace
+typedef struct {
+    uint64_t arrivalUs;                     ///< Arrival on the simulated clock
+    TaskCommandEnum command;                ///< Command of the task
+    std::vector<std::string> parameters;    ///< Parameters of the task
+}TraceTask;
+
+/// \brief      Names of the commands accepted in a trace
+static const std::map<std::string, TaskCommandEnum> commandNames = {
+    {"ADDFILTER", TaskCommandEnum::ADDFILTER},
+    {"REQUESTADDFILTER", TaskCommandEnum::REQUESTADDFILTER},
+    {"CANCELADDFILTER", TaskCommandEnum::CANCELADDFILTER},
+    {"REMOVEFILTER", TaskCommandEnum::REMOVEFILTER},
+    {"REQUESTREMOVEFILTER", TaskCommandEnum::REQUESTREMOVEFILTER},
+    {"CANCELREMOVEFILTER", TaskCommandEnum::CANCELREMOVEFILTER},
+    {"GETFILTERS", TaskCommandEnum::GETFILTERS},
+    {"ADDFILTERCOMBINATION", TaskCommandEnum::ADDFILTERCOMBINATION},
+    {"REMOVEFILTERCOMBINATION", TaskCommandEnum::REMOVEFILTERCOMBINATION},
+    {"GETFILTERCOMBINATIONS", TaskCommandEnum::GETFILTERCOMBINATIONS},
+    {"PLACECOMBINATION", TaskCommandEnum::PLACECOMBINATION},
+    {"REMOVECOMBINATION", TaskCommandEnum::REMOVECOMBINATION},
+    {"GETSYSTEMSTATUS", TaskCommandEnum::GETSYSTEMSTATUS},
+    {"GETSYSTEMLOG", TaskCommandEnum::GETSYSTEMLOG},
+    {"STOP", TaskCommandEnum::STOP},
+    {"RESET", TaskCommandEnum::RESET},
+    {"GETFILTERSBYMATERIAL", TaskCommandEnum::GETFILTERSBYMATERIAL},
+    {"GETFILTERSBYTHICKNESS", TaskCommandEnum::GETFILTERSBYTHICKNESS},
+    {"GETFREEDRAWER", TaskCommandEnum::GETFREEDRAWER},
+    {"GETMETRICS", TaskCommandEnum::GETMETRICS}
+};
+
+/// \brief      Queue handler that notes when the last message of every task was sent
+class ReplayQueueHandler : public IQueueHandler
+{
+public:
+    /// \brief      Constructor
+    /// \param[in]  hal Simulated HAL whose clock times the messages
+    ReplayQueueHandler(SimHal* hal) : hal(hal) {}
+
+    void AddTask(Task task) override {
+        lastMessageUs[task.GetMessageID()] = hal->GetTime();
+    }
+
+    /// \brief      Time of the last message per message ID
+    std::map<int, uint64_t> lastMessageUs;
+
+private:
+    SimHal* hal;
+};
+
+/// \brief      Read a trace file
+/// \pre        None
+/// \post       Tasks appended in file order
+/// \param[in]  path Trace file
+/// \param[out] tasks Tasks of the trace
+/// \returns    -1 on error, 0 on success
+static int ReadTrace(const char* path, std::vector<TraceTask>& tasks){
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::fprintf(stderr, "Unable to open %s\n", path);
+        return -1;
+    }
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        if (line.back() != ';') {
+            std::fprintf(stderr, "%s:%d: missing ;\n", path, lineNumber);
+            return -1;
+        }
+        line.pop_back();
+        std::vector<std::string> fields;
+        size_t start = 0;
+        while (true) {
+            size_t split = line.find(',', start);
+            fields.push_back(line.substr(start, split - start));
+            if (split == std::string::npos) break;
+            start = split + 1;
+        }
+        char* end = NULL;
+        double arrival = std::strtod(fields.at(0).c_str(), &end);
+        auto command = fields.size() > 1 ? commandNames.find(fields.at(1)) : commandNames.end();
+        if (end == fields.at(0).c_str() || *end != '\0' || arrival < 0 || command == commandNames.end()) {
+            std::fprintf(stderr, "%s:%d: invalid task\n", path, lineNumber);
+            return -1;
+        }
+        TraceTask task;
+        task.arrivalUs = (uint64_t)(arrival * 1e6);
+        task.command = command->second;
+        task.parameters.assign(fields.begin() + 2, fields.end());
+        if (!tasks.empty() && task.arrivalUs < tasks.back().arrivalUs) {
+            std::fprintf(stderr, "%s:%d: arrival before previous task\n", path, lineNumber);
+            return -1;
+        }
+        tasks.push_back(task);
+    }
+    return 0;
+}
+
+int main(int argc, char** argv){
+    if (argc != 2) {
+        std::fprintf(stderr, "Usage: %s <trace file>\n", argv[0]);
+        return 2;
+    }
+    std::vector<TraceTask> tasks;
+    if (ReadTrace(argv[1], tasks) < 0) return 1;
+
+    // Logic keeps its database in the working directory
+    char directory[] = "/tmp/tracereplay.XXXXXX";
+    if (mkdtemp(directory) == NULL || chdir(directory) < 0) {
+        std::fprintf(stderr, "Unable to create working directory\n");
+        return 1;
+    }
+
+    SimHal sim(REPLAY_DRAWER_COUNT, REPLAY_CRANE_RANGE);
+    ReplayQueueHandler queueHandler(&sim);
+    {
+        Logic logic(&queueHandler, &sim);
+        FastLog::SetLevel(FASTLOG_LEVEL_WARNING);
+        size_t next = 0;
+        uint64_t lastStepCount = UINT64_MAX;
+        while (true) {
+            for (; next < tasks.size() && tasks.at(next).arrivalUs <= sim.GetTime(); next++) {
+                // Message IDs start at 1, the position in the trace
+                Task task((int)next + 1, 0, 0, tasks.at(next).command, TaskTypeEnum::REQUESTMESSAGE);
+                for (const std::string& parameter : tasks.at(next).parameters) task.AddParameter(parameter);
+                logic.callback(task);
+            }
+            logic.Run();
+            // Idle once a Run() neither found the HAL busy nor ran a step
+            uint64_t stepCount = logic.GetRunStatistics().stepCount;
+            bool idle = sim.getStatus() != HalStatus::BUSY && stepCount == lastStepCount;
+            lastStepCount = stepCount;
+            if (!idle) continue;
+            if (next == tasks.size()) break;
+            sim.Advance(tasks.at(next).arrivalUs - sim.GetTime());
+        }
+    }
+
+    LatencyHistogram latencies[METRICS_COMMAND_COUNT];
+    int unanswered = 0;
+    for (size_t i = 0; i < tasks.size(); i++) {
+        auto sent = queueHandler.lastMessageUs.find((int)i + 1);
+        int command = (int)tasks.at(i).command;
+        if (sent == queueHandler.lastMessageUs.end()) unanswered++;
+        else if (command < METRICS_COMMAND_COUNT) latencies[command].Record(sent->second - tasks.at(i).arrivalUs);
+    }
+
+    SimHalStatistics statistics = sim.GetStatistics();
+    double hours = sim.GetTime() / 3.6e9;
+    std::printf("Tasks            %zu\n", tasks.size());
+    std::printf("Unanswered       %d\n", unanswered);
+    std::printf("Simulated time   %.1f s\n", sim.GetTime() / 1e6);
+    std::printf("Busy time        %.1f s\n", statistics.busyUs / 1e6);
+    std::printf("Crane travel     %llu\n", (unsigned long long)statistics.craneTravel);
+    std::printf("Operations       %llu\n", (unsigned long long)statistics.operationCount);
+    std::printf("HAL errors       %llu\n", (unsigned long long)statistics.errorCount);
+    std::printf("Tasks/hour       %.1f\n", hours > 0 ? tasks.size() / hours : 0.0);
+    std::printf("\n%-24s %6s %9s %9s %9s %9s\n", "Command", "Count", "p50 s", "p90 s", "p99 s", "Max s");
+    for (const auto& name : commandNames) {
+        const LatencyHistogram& histogram = latencies[(int)name.second];
+        if (histogram.GetCount() == 0) continue;
+        std::printf("%-24s %6llu %9.2f %9.2f %9.2f %9.2f\n", name.first.c_str(),
+            (unsigned long long)histogram.GetCount(),
+            histogram.GetPercentile(50) / 1e6, histogram.GetPercentile(90) / 1e6,
+            histogram.GetPercentile(99) / 1e6, histogram.GetMax() / 1e6);
+    }
+
+    unlink("database.txt");
+    unlink("database.txt.tmp");
+    unlink("database.journal");
+    rmdir(directory);
+    return 0;
+}